@@ -84,11 +84,11 @@ static void init_analysis( struct analysis* analysis, struct task* task ) {
 }
 
 static void analyze_scripts( struct analysis* analysis ) {
-   struct list_iter i;
-   list_iterate( &analysis->task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      analyze_script( analysis, list_data( &i ) );
-      list_next( &i );
+   for ( u32 i = 0; i < vec_size( &analysis->task->scripts ); ++i ) {
+      struct script* script = vec_at( &analysis->task->scripts, i );
+      if ( script->selected && ! script->cache.text ) {
+         analyze_script( analysis, script );
+      }
    }
 }
 
@@ -98,17 +98,14 @@ static void analyze_script( struct analysis* analysis,
 }
 
 static void analyze_block( struct analysis* analysis, struct block* block ) {
-   struct list_iter i;
-   list_iterate( &block->stmts, &i );
-   while ( ! list_end( &i ) ) {
+   for ( u32 i = 0; i < vec_size( &block->stmts ); ++i ) {
       struct stmt_analysis stmt_analysis = { NULL };
-      analyze_stmt( analysis, &stmt_analysis, list_data( &i ) );
+      analyze_stmt( analysis, &stmt_analysis, vec_at( &block->stmts, i ) );
       if ( stmt_analysis.replacement ) {
-         struct node* replaced_node = list_replace( &block->stmts, &i,
+         struct node* replaced_node = vec_replace( &block->stmts, i,
             stmt_analysis.replacement );
          // t_free_node( replaced_node );
       }
-      list_next( &i );
    }
 }
 
@@ -576,7 +576,8 @@ static void setup_deds( struct setup* setup ) {
 
 void setup_func( struct setup* setup, size_t entry ) {
    struct func* func = t_alloc_func();
-   str_append( &func->name, g_funcs[ entry ].name );
+   func->name = str_table_intern( &setup->task->str_table,
+      g_funcs[ entry ].name );
    // Dedicated function.
    if ( entry < BOUND_DED ) {
       struct func_ded* more = mem_alloc( sizeof( *more ) );
@@ -622,7 +623,8 @@ static void setup_formats( struct setup* setup ) {
    for ( size_t i = 0; i < ARRAY_SIZE( g_formats ); ++i ) {
       struct func* func = t_alloc_func();
       func->type = FUNC_FORMAT;
-      str_append( &func->name, g_formats[ i ].name );
+      func->name = str_table_intern( &setup->task->str_table,
+      g_formats[ i ].name );
       struct func_format* more = mem_alloc( sizeof( *more ) );
       more->opcode = g_formats[ i ].opcode;
       func->more.format = more;
@@ -654,7 +656,8 @@ static void setup_exts( struct setup* setup ) {
    for ( size_t i = 0; i < ARRAY_SIZE( g_exts ); ++i ) {
       struct func* func = t_alloc_func();
       func->type = FUNC_EXT;
-      str_append( &func->name, g_exts[ i ].name );
+      func->name = str_table_intern( &setup->task->str_table,
+      g_exts[ i ].name );
       struct func_ext* more = mem_alloc( sizeof( *more ) );
       more->id = g_exts[ i ].id;
       func->more.ext = more;
@@ -686,7 +689,8 @@ static void setup_interns( struct setup* setup ) {
    for ( size_t i = 0; i < ARRAY_SIZE( g_interns ); ++i ) {
       struct func* func = t_alloc_func();
       func->type = FUNC_INTERN;
-      str_append( &func->name, g_interns[ i ].name );
+      func->name = str_table_intern( &setup->task->str_table,
+      g_interns[ i ].name );
       struct func_intern* more = mem_alloc( sizeof( *more ) );
       more->id = g_interns[ i ].id;
       func->more.intern = more;
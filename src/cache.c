@@ -0,0 +1,558 @@
+/**
+ * Output cache.
+ *
+ * The source code decompiled from an object is stored in a directory in the
+ * cache directory of the user. An entry is named after a hash of the object data and
+ * of the options that change the output, so decompiling the same object again
+ * copies the stored source code instead of running the stages.
+ *
+ * The source code of each script and function is stored in the same directory
+ * too, named after a hash of the pcode of the body. An object that differs
+ * from another only in some of its bodies decompiles just those bodies.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "task.h"
+
+// Version of the cached output. Increase the version whenever a change makes
+// the decompiler produce different output for the same object, so output
+// stored by an older version is no longer used.
+static const char* g_cache_version = "acsde-cache-1";
+
+enum { COPY_BUFFER_SIZE = 64 * 1024 };
+
+static const u64 FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+static char* create_cache_dir( void );
+static u64 hash_entry( struct options* options, struct object_input* input );
+static u64 hash_bytes( u64 hash, const void* data, size_t size );
+static u64 hash_cstr( u64 hash, const char* value );
+static u64 hash_i32( u64 hash, i32 value );
+static bool body_cacheable( struct pcode* start, void* arrays );
+static u64 hash_script( struct task* task, struct script* script );
+static u64 hash_func( struct task* task, struct func* func );
+static u64 hash_body( struct task* task, u64 hash, struct pcode* start,
+   struct pcode* end );
+static bool has_loose_strings( struct pcode* start, struct pcode* end );
+static u64 hash_destination( u64 hash, struct pcode* start,
+   struct pcode* destination );
+static u64 hash_callee( struct task* task, u64 hash,
+   struct generic_pcode* generic );
+static u64 hash_literals( struct task* task, u64 hash,
+   struct generic_pcode* generic, bool printed, bool loose_strings );
+static u64 hash_string( struct task* task, u64 hash, i32 index );
+static bool prints_string( struct pcode* pcode );
+static bool pushes_literal( struct pcode* pcode );
+static bool printed_literal( struct pcode* pcode );
+static void fetch_body( struct task* task, struct cached_body* body );
+static char* read_body_file( const char* path );
+static char* format_path( const char* format, ... );
+static bool copy_to_output( const char* path, const char* output_file );
+static bool copy_file( FILE* from, FILE* to );
+
+/**
+ * Determines where the source code of the object is cached. The memory
+ * statistics describe the stages, so the output is not cached when the
+ * statistics are wanted.
+ */
+void t_init_cache_entry( struct cache_entry* entry, struct options* options,
+   struct object_input* input ) {
+   entry->dir = NULL;
+   entry->path = NULL;
+   entry->temp_path = NULL;
+   if ( ! options->use_cache || options->mem_stats ) {
+      return;
+   }
+   char* dir = create_cache_dir();
+   if ( ! dir ) {
+      return;
+   }
+   u64 hash = hash_entry( options, input );
+   char* path = format_path( "%s" OS_PATHSEP "%016llx-%zx.acs", dir, hash,
+      input->size );
+   // The stages write to the temporary file by name, so the file is only
+   // created here, to reserve a name no other run uses.
+   char* temp_path = format_path( "%s.XXXXXX", path );
+   FILE* fh = fs_create_temp_file( temp_path );
+   if ( fh ) {
+      fclose( fh );
+      entry->dir = dir;
+      entry->path = path;
+      entry->temp_path = temp_path;
+   }
+   else {
+      free( temp_path );
+      free( path );
+      free( dir );
+   }
+}
+
+// Cached output is copied to the output without being checked, so the cache
+// is kept in a directory that only the user can write to. Returns NULL when
+// there is no such directory.
+static char* create_cache_dir( void ) {
+   char* home = fs_get_cache_home();
+   if ( ! home ) {
+      return NULL;
+   }
+   struct fs_query query;
+   fs_init_query( &query, home );
+   struct fs_result result;
+   if ( ! fs_exists( &query ) ) {
+      fs_create_private_dir( home, &result );
+   }
+   char* dir = format_path( "%s" OS_PATHSEP "acsde", home );
+   free( home );
+   if ( ! fs_create_private_dir( dir, &result ) ) {
+      free( dir );
+      return NULL;
+   }
+   return dir;
+}
+
+// 64-bit FNV-1a. The library name of a lump and the selected scripts and
+// functions change the output, so they are hashed along with the object.
+static u64 hash_entry( struct options* options, struct object_input* input ) {
+   u64 hash = hash_cstr( FNV_OFFSET_BASIS, g_cache_version );
+   hash = hash_cstr( hash, input->lump_name ? input->lump_name : "" );
+   for ( u32 i = 0; i < options->num_selections; ++i ) {
+      u8 func = options->selections[ i ].func;
+      hash = hash_bytes( hash, &func, sizeof( func ) );
+      hash = hash_cstr( hash, options->selections[ i ].value );
+   }
+   return hash_bytes( hash, input->data, input->size );
+}
+
+static u64 hash_bytes( u64 hash, const void* data, size_t size ) {
+   const u8* bytes = data;
+   for ( size_t i = 0; i < size; ++i ) {
+      hash ^= bytes[ i ];
+      hash *= 1099511628211ull;
+   }
+   return hash;
+}
+
+// The terminating NUL character is hashed too, so consecutive strings cannot
+// be confused with each other.
+static u64 hash_cstr( u64 hash, const char* value ) {
+   return hash_bytes( hash, value, strlen( value ) + 1 );
+}
+
+static u64 hash_i32( u64 hash, i32 value ) {
+   return hash_bytes( hash, &value, sizeof( value ) );
+}
+
+static char* format_path( const char* format, ... ) {
+   va_list args;
+   va_start( args, format );
+   int length = vsnprintf( NULL, 0, format, args );
+   va_end( args );
+   char* path = mem_system_alloc( ( size_t ) length + 1 );
+   va_start( args, format );
+   vsnprintf( path, ( size_t ) length + 1, format, args );
+   va_end( args );
+   return path;
+}
+
+/**
+ * Copies the cached source code to the output.
+ */
+enum cache_fetch t_fetch_cache_entry( struct cache_entry* entry,
+   const char* output_file ) {
+   if ( ! entry->path ) {
+      return CACHE_MISS;
+   }
+   struct fs_query query;
+   fs_init_query( &query, entry->path );
+   if ( ! fs_exists( &query ) ) {
+      return CACHE_MISS;
+   }
+   return copy_to_output( entry->path, output_file ) ? CACHE_HIT :
+      CACHE_ERROR;
+}
+
+/**
+ * Moves the source code written to the temporary file into the cache, and
+ * copies it to the output. When the source code is not to be kept, or another
+ * run stored the same entry first, the source code is copied from the
+ * temporary file instead.
+ */
+bool t_store_cache_entry( struct cache_entry* entry, bool keep,
+   const char* output_file ) {
+   if ( keep && rename( entry->temp_path, entry->path ) == 0 ) {
+      // Another run can now be given the same temporary name, so the file
+      // must not be removed later.
+      free( entry->temp_path );
+      entry->temp_path = NULL;
+      return copy_to_output( entry->path, output_file );
+   }
+   return copy_to_output( entry->temp_path, output_file );
+}
+
+static bool copy_to_output( const char* path, const char* output_file ) {
+   FILE* from = fopen( path, "r" );
+   if ( ! from ) {
+      printf( "error: failed to read cached output: \"%s\": %s\n", path,
+         strerror( errno ) );
+      return false;
+   }
+   FILE* to = stdout;
+   if ( output_file ) {
+      to = fopen( output_file, "w" );
+      if ( ! to ) {
+         printf( "error: failed to open output file: \"%s\": %s\n",
+            output_file, strerror( errno ) );
+         fclose( from );
+         return false;
+      }
+   }
+   bool copied = copy_file( from, to );
+   int err = errno;
+   if ( to != stdout ) {
+      if ( fclose( to ) != 0 && copied ) {
+         copied = false;
+         err = errno;
+      }
+   }
+   else if ( fflush( to ) != 0 && copied ) {
+      copied = false;
+      err = errno;
+   }
+   fclose( from );
+   if ( ! copied ) {
+      printf( "error: failed to write output: \"%s\": %s\n",
+         output_file ? output_file : "standard output", strerror( err ) );
+   }
+   return copied;
+}
+
+// Returns false when the source code cannot be read or written completely.
+static bool copy_file( FILE* from, FILE* to ) {
+   char* buffer = mem_system_alloc( COPY_BUFFER_SIZE );
+   bool copied = true;
+   size_t size = 0;
+   while ( copied &&
+      ( size = fread( buffer, 1, COPY_BUFFER_SIZE, from ) ) > 0 ) {
+      copied = ( fwrite( buffer, 1, size, to ) == size );
+   }
+   free( buffer );
+   return ( copied && ! ferror( from ) );
+}
+
+/**
+ * Removes the temporary file, if it is still around.
+ */
+void t_deinit_cache_entry( struct cache_entry* entry ) {
+   if ( entry->temp_path ) {
+      fs_delete_file( entry->temp_path );
+   }
+   free( entry->dir );
+   free( entry->path );
+   free( entry->temp_path );
+}
+
+/**
+ * Looks up the selected scripts and functions in the body cache. A body found
+ * in the cache is not decompiled, and its stored source code is written
+ * instead.
+ */
+void t_fetch_cached_bodies( struct task* task ) {
+   if ( ! task->cache_dir ) {
+      return;
+   }
+   for ( u32 i = 0; i < vec_size( &task->scripts ); ++i ) {
+      struct script* script = vec_at( &task->scripts, i );
+      if ( script->selected &&
+         body_cacheable( script->body_start, script->arrays ) ) {
+         script->cache.key = hash_script( task, script );
+         fetch_body( task, &script->cache );
+      }
+   }
+   for ( u32 i = 0; i < vec_size( &task->funcs ); ++i ) {
+      struct func* func = vec_at( &task->funcs, i );
+      struct func_user* user = func->more.user;
+      if ( user->selected && body_cacheable( user->start, user->arrays ) ) {
+         user->cache.key = hash_func( task, func );
+         fetch_body( task, &user->cache );
+      }
+   }
+}
+
+// The dimensions of local arrays are stored apart from the body, so a body
+// with local arrays is not cached.
+static bool body_cacheable( struct pcode* start, void* arrays ) {
+   return ( start != NULL && arrays == NULL );
+}
+
+// The header of a script is part of its source code.
+static u64 hash_script( struct task* task, struct script* script ) {
+   u64 hash = hash_cstr( FNV_OFFSET_BASIS, g_cache_version );
+   hash = hash_cstr( hash, "script" );
+   hash = hash_i32( hash, script->named_script );
+   if ( script->named_script ) {
+      hash = hash_cstr( hash, script->name->value );
+   }
+   else {
+      hash = hash_i32( hash, script->number );
+   }
+   hash = hash_i32( hash, ( i32 ) script->type );
+   hash = hash_i32( hash, ( i32 ) script->flags );
+   hash = hash_i32( hash, ( i32 ) script->num_param );
+   hash = hash_i32( hash, ( i32 ) script->num_vars );
+   return hash_body( task, hash, script->body_start, script->body_end );
+}
+
+static u64 hash_func( struct task* task, struct func* func ) {
+   u64 hash = hash_cstr( FNV_OFFSET_BASIS, g_cache_version );
+   hash = hash_cstr( hash, "function" );
+   hash = hash_cstr( hash, func->name ? func->name->value : "" );
+   hash = hash_i32( hash, ( i32 ) func->more.user->index );
+   hash = hash_i32( hash, func->return_spec );
+   hash = hash_i32( hash, func->min_param );
+   hash = hash_i32( hash, func->max_param );
+   hash = hash_i32( hash, ( i32 ) func->more.user->num_vars );
+   return hash_body( task, hash, func->more.user->start,
+      func->more.user->end );
+}
+
+// The same body is found at a different position in each object, and its
+// strings have different indexes in each string table. So the destination of
+// a jump is hashed as a position relative to the start of the body, and a
+// string that is printed is hashed by its contents.
+static u64 hash_body( struct task* task, u64 hash, struct pcode* start,
+   struct pcode* end ) {
+   bool loose_strings = has_loose_strings( start, end );
+   struct pcode* pcode = start;
+   while ( pcode != PCODE_NEXT( end ) ) {
+      hash = hash_i32( hash, pcode->opcode );
+      switch ( pcode->opcode ) {
+      case PCD_GOTO:
+      case PCD_IFGOTO:
+      case PCD_IFNOTGOTO:
+         hash = hash_destination( hash, start,
+            ( ( struct jump_pcode* ) pcode )->destination );
+         break;
+      case PCD_CASEGOTO: {
+            struct casejump_pcode* jump = ( struct casejump_pcode* ) pcode;
+            hash = hash_i32( hash, jump->value );
+            hash = hash_destination( hash, start, jump->destination );
+         }
+         break;
+      case PCD_CASEGOTOSORTED: {
+            struct sortedcasejump_pcode* jump =
+               ( struct sortedcasejump_pcode* ) pcode;
+            hash = hash_i32( hash, jump->count );
+            for ( i32 i = 0; i < jump->count; ++i ) {
+               hash = hash_i32( hash, jump->cases[ i ].value );
+               hash = hash_destination( hash, start,
+                  jump->cases[ i ].destination );
+            }
+         }
+         break;
+      case PCD_CALL:
+      case PCD_CALLDISCARD:
+      case PCD_PUSHFUNCTION:
+         hash = hash_callee( task, hash, ( struct generic_pcode* ) pcode );
+         break;
+      default:
+         hash = hash_literals( task, hash, ( struct generic_pcode* ) pcode,
+            printed_literal( pcode ), loose_strings );
+      }
+      pcode = PCODE_NEXT( pcode );
+   }
+   return hash;
+}
+
+// A string is printed by its contents when the string index is pushed right
+// before the print instruction, and no jump lands on the print instruction.
+// Otherwise, the index might come from any number in the body.
+static bool has_loose_strings( struct pcode* start, struct pcode* end ) {
+   struct pcode* pcode = start;
+   while ( pcode != PCODE_NEXT( end ) ) {
+      if ( prints_string( pcode ) && ( pcode == start ||
+         ! pushes_literal( PCODE_PREV( pcode ) ) ) ) {
+         return true;
+      }
+      switch ( pcode->opcode ) {
+      case PCD_GOTO:
+      case PCD_IFGOTO:
+      case PCD_IFNOTGOTO:
+         if ( prints_string(
+            ( ( struct jump_pcode* ) pcode )->destination ) ) {
+            return true;
+         }
+         break;
+      case PCD_CASEGOTO:
+         if ( prints_string(
+            ( ( struct casejump_pcode* ) pcode )->destination ) ) {
+            return true;
+         }
+         break;
+      case PCD_CASEGOTOSORTED: {
+            struct sortedcasejump_pcode* jump =
+               ( struct sortedcasejump_pcode* ) pcode;
+            for ( i32 i = 0; i < jump->count; ++i ) {
+               if ( prints_string( jump->cases[ i ].destination ) ) {
+                  return true;
+               }
+            }
+         }
+         break;
+      default:
+         break;
+      }
+      pcode = PCODE_NEXT( pcode );
+   }
+   return false;
+}
+
+static u64 hash_destination( u64 hash, struct pcode* start,
+   struct pcode* destination ) {
+   return hash_i32( hash, ( i32 ) ( ( union pcode_slot* ) destination -
+      ( union pcode_slot* ) start ) );
+}
+
+// The name and the signature of the called function appear in the source
+// code of the body.
+static u64 hash_callee( struct task* task, u64 hash,
+   struct generic_pcode* generic ) {
+   hash = hash_i32( hash, generic->args[ 0 ] );
+   struct func* func = t_find_func( task, ( u32 ) generic->args[ 0 ] );
+   if ( func ) {
+      hash = hash_cstr( hash, func->name ? func->name->value : "" );
+      hash = hash_i32( hash, func->return_spec );
+      hash = hash_i32( hash, func->min_param );
+      hash = hash_i32( hash, func->max_param );
+   }
+   return hash;
+}
+
+// Only the last value pushed by an instruction reaches the print instruction
+// that follows it.
+static u64 hash_literals( struct task* task, u64 hash,
+   struct generic_pcode* generic, bool printed, bool loose_strings ) {
+   hash = hash_i32( hash, generic->num_args );
+   for ( i32 i = 0; i < generic->num_args; ++i ) {
+      if ( printed && i == generic->num_args - 1 ) {
+         hash = hash_string( task, hash, generic->args[ i ] );
+      }
+      else {
+         hash = hash_i32( hash, generic->args[ i ] );
+         if ( loose_strings ) {
+            hash = hash_string( task, hash, generic->args[ i ] );
+         }
+      }
+   }
+   return hash;
+}
+
+// A missing string is printed as a number. A string that cannot be decoded is
+// hashed as missing too. Printing such a string makes the stages fail, and then
+// the body is not cached anyway.
+static u64 hash_string( struct task* task, u64 hash, i32 index ) {
+   const char* string = t_find_string( task, ( u32 ) index );
+   if ( string ) {
+      hash = hash_i32( hash, 1 );
+      return hash_cstr( hash, string );
+   }
+   else {
+      hash = hash_i32( hash, 0 );
+      return hash_i32( hash, index );
+   }
+}
+
+static bool prints_string( struct pcode* pcode ) {
+   switch ( pcode->opcode ) {
+   case PCD_PRINTSTRING:
+   case PCD_PRINTLOCALIZED:
+   case PCD_PRINTBIND:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static bool pushes_literal( struct pcode* pcode ) {
+   switch ( pcode->opcode ) {
+   case PCD_PUSHNUMBER:
+   case PCD_PUSHBYTE:
+   case PCD_PUSH2BYTES:
+   case PCD_PUSH3BYTES:
+   case PCD_PUSH4BYTES:
+   case PCD_PUSH5BYTES:
+   case PCD_PUSHBYTES:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static bool printed_literal( struct pcode* pcode ) {
+   return ( pushes_literal( pcode ) && prints_string( PCODE_NEXT( pcode ) ) );
+}
+
+static void fetch_body( struct task* task, struct cached_body* body ) {
+   body->reusable = true;
+   char* path = format_path( "%s" OS_PATHSEP "body-%016llx.acs",
+      task->cache_dir, body->key );
+   char* text = read_body_file( path );
+   if ( text ) {
+      int calls_aspec = 0;
+      int calls_ext = 0;
+      int length = 0;
+      if ( sscanf( text, "%d %d\n%n", &calls_aspec, &calls_ext,
+         &length ) == 2 && length > 0 && text[ length ] != '\0' ) {
+         body->text = text + length;
+         body->calls_aspec = ( calls_aspec != 0 );
+         body->calls_ext = ( calls_ext != 0 );
+         task->calls_aspec = ( task->calls_aspec || body->calls_aspec );
+         task->calls_ext = ( task->calls_ext || body->calls_ext );
+      }
+   }
+   free( path );
+}
+
+// Returns NULL when the body is not in the cache.
+static char* read_body_file( const char* path ) {
+   FILE* fh = fopen( path, "rb" );
+   if ( ! fh ) {
+      return NULL;
+   }
+   char* text = NULL;
+   if ( fseek( fh, 0, SEEK_END ) == 0 ) {
+      long size = ftell( fh );
+      if ( size > 0 && fseek( fh, 0, SEEK_SET ) == 0 ) {
+         text = mem_alloc( ( size_t ) size + 1 );
+         size_t count = fread( text, 1, ( size_t ) size, fh );
+         text[ count ] = '\0';
+      }
+   }
+   fclose( fh );
+   return text;
+}
+
+/**
+ * Stores the source code of a script or function in the body cache. The source
+ * code is written to a temporary file first, so another run never reads a
+ * partially written entry.
+ */
+void t_store_cached_body( struct task* task, struct cached_body* body,
+   const char* text ) {
+   char* path = format_path( "%s" OS_PATHSEP "body-%016llx.acs",
+      task->cache_dir, body->key );
+   char* temp_path = format_path( "%s.XXXXXX", path );
+   FILE* fh = fs_create_temp_file( temp_path );
+   if ( fh ) {
+      fprintf( fh, "%d %d\n%s", body->calls_aspec, body->calls_ext, text );
+      bool written = ( ferror( fh ) == 0 );
+      if ( fclose( fh ) != 0 || ! written ||
+         rename( temp_path, path ) != 0 ) {
+         fs_delete_file( temp_path );
+      }
+   }
+   free( temp_path );
+   free( path );
+}
@@ -0,0 +1,420 @@
+/*
+
+   Control-Flow Graph
+
+   The pcode of a script or function is split into basic blocks, connected by
+   the jumps between them. The dominator tree of the graph is then found, so
+   the Annotation stage can tell a jump that closes a loop from any other
+   backward jump.
+
+   Each step takes time linear in the size of the body, except for the
+   dominator tree, which is found with the iterative algorithm of Cooper,
+   Harvey, and Kennedy. For code produced by a compiler, that algorithm only
+   needs a couple of passes.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "task.h"
+
+static void find_blocks( struct cfg* cfg, struct pcode* start,
+   struct pcode* end );
+static u32 slot_of( struct cfg* cfg, struct pcode* pcode );
+static bool ends_block( struct pcode* pcode );
+static void mark_targets( struct cfg* cfg, bool* leaders,
+   struct pcode* pcode );
+static void init_block( struct cfg_block* block, struct pcode* start );
+static void connect_blocks( struct cfg* cfg );
+static u32 add_successors( struct cfg* cfg, u32 block, u32* edges );
+static u32 add_edge( u32* edges, u32 count, u32 block );
+static void add_predecessors( struct cfg* cfg );
+static void find_dominators( struct cfg* cfg );
+static u32 order_blocks( struct cfg* cfg, u32* order );
+static u32 intersect( struct cfg* cfg, u32 a, u32 b );
+static void number_tree( struct cfg* cfg, u32* order, u32 num_reached );
+static u32 block_of( struct cfg* cfg, struct pcode* pcode );
+static bool reachable( struct cfg* cfg, u32 block );
+static bool dominates( struct cfg* cfg, u32 a, u32 b );
+
+/**
+ * Builds the control-flow graph of the pcode from start to end. The pcode
+ * right after the end, the trailing sentinel, is part of the graph, because a
+ * jump can land on it. The graph is allocated from the selected arena, and is
+ * released with the arena.
+ */
+void t_build_cfg( struct cfg* cfg, struct pcode* start, struct pcode* end ) {
+   cfg->start = start;
+   cfg->num_slots = ( u32 ) ( ( union pcode_slot* ) PCODE_NEXT( end ) -
+      ( union pcode_slot* ) start ) + 1;
+   find_blocks( cfg, start, end );
+   connect_blocks( cfg );
+   find_dominators( cfg );
+}
+
+// A block starts at the start of the body, at the destination of a jump, and
+// right after a pcode that ends a block.
+static void find_blocks( struct cfg* cfg, struct pcode* start,
+   struct pcode* end ) {
+   bool* leaders = mem_alloc( sizeof( leaders[ 0 ] ) * cfg->num_slots );
+   memset( leaders, 0, sizeof( leaders[ 0 ] ) * cfg->num_slots );
+   leaders[ 0 ] = true;
+   struct pcode* last = PCODE_NEXT( end );
+   struct pcode* pcode = start;
+   u32 slot = 0;
+   while ( pcode != PCODE_NEXT( last ) ) {
+      mark_targets( cfg, leaders, pcode );
+      if ( ends_block( pcode ) && slot + 1 < cfg->num_slots ) {
+         leaders[ slot + 1 ] = true;
+      }
+      pcode = PCODE_NEXT( pcode );
+      ++slot;
+   }
+   u32 num_blocks = 0;
+   for ( u32 i = 0; i < cfg->num_slots; ++i ) {
+      if ( leaders[ i ] ) {
+         ++num_blocks;
+      }
+   }
+   cfg->num_blocks = num_blocks;
+   cfg->blocks = mem_alloc( sizeof( cfg->blocks[ 0 ] ) * cfg->num_blocks );
+   cfg->block_of = mem_alloc( sizeof( cfg->block_of[ 0 ] ) *
+      cfg->num_slots );
+   u32 block = 0;
+   pcode = start;
+   for ( u32 i = 0; i < cfg->num_slots; ++i ) {
+      if ( leaders[ i ] ) {
+         if ( i > 0 ) {
+            ++block;
+         }
+         init_block( &cfg->blocks[ block ], pcode );
+      }
+      cfg->blocks[ block ].end = pcode;
+      cfg->block_of[ i ] = block;
+      pcode = PCODE_NEXT( pcode );
+   }
+   mem_free( leaders );
+}
+
+static u32 slot_of( struct cfg* cfg, struct pcode* pcode ) {
+   return ( u32 ) ( ( union pcode_slot* ) pcode -
+      ( union pcode_slot* ) cfg->start );
+}
+
+static bool ends_block( struct pcode* pcode ) {
+   switch ( pcode->opcode ) {
+   case PCD_GOTO:
+   case PCD_IFGOTO:
+   case PCD_IFNOTGOTO:
+   case PCD_CASEGOTO:
+   case PCD_CASEGOTOSORTED:
+   case PCD_TERMINATE:
+   case PCD_RESTART:
+   case PCD_RETURNVOID:
+   case PCD_RETURNVAL:
+   case PCD_GOTOSTACK:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static void mark_targets( struct cfg* cfg, bool* leaders,
+   struct pcode* pcode ) {
+   switch ( pcode->opcode ) {
+   case PCD_GOTO:
+   case PCD_IFGOTO:
+   case PCD_IFNOTGOTO:
+      leaders[ slot_of( cfg,
+         ( ( struct jump_pcode* ) pcode )->destination ) ] = true;
+      break;
+   case PCD_CASEGOTO:
+      leaders[ slot_of( cfg,
+         ( ( struct casejump_pcode* ) pcode )->destination ) ] = true;
+      break;
+   case PCD_CASEGOTOSORTED: {
+         struct sortedcasejump_pcode* jump =
+            ( struct sortedcasejump_pcode* ) pcode;
+         for ( i32 i = 0; i < jump->count; ++i ) {
+            leaders[ slot_of( cfg, jump->cases[ i ].destination ) ] = true;
+         }
+      }
+      break;
+   default:
+      break;
+   }
+}
+
+static void init_block( struct cfg_block* block, struct pcode* start ) {
+   block->start = start;
+   block->end = start;
+   block->first_succ = 0;
+   block->num_succs = 0;
+   block->first_pred = 0;
+   block->num_preds = 0;
+}
+
+// The edges are kept in two arrays, one for the successors and one for the
+// predecessors. The edges of a block are next to each other in the arrays.
+static void connect_blocks( struct cfg* cfg ) {
+   u32 num_edges = 0;
+   for ( u32 i = 0; i < cfg->num_blocks; ++i ) {
+      num_edges += add_successors( cfg, i, NULL );
+   }
+   cfg->num_edges = num_edges;
+   cfg->succs = mem_alloc( sizeof( cfg->succs[ 0 ] ) * ( num_edges + 1 ) );
+   cfg->preds = mem_alloc( sizeof( cfg->preds[ 0 ] ) * ( num_edges + 1 ) );
+   u32 edge = 0;
+   for ( u32 i = 0; i < cfg->num_blocks; ++i ) {
+      cfg->blocks[ i ].first_succ = edge;
+      cfg->blocks[ i ].num_succs = add_successors( cfg, i,
+         &cfg->succs[ edge ] );
+      edge += cfg->blocks[ i ].num_succs;
+   }
+   add_predecessors( cfg );
+}
+
+// When the edges are NULL, the successors are only counted. A block that
+// leaves the body has no successors.
+static u32 add_successors( struct cfg* cfg, u32 block, u32* edges ) {
+   struct pcode* pcode = cfg->blocks[ block ].end;
+   u32 next = block + 1;
+   u32 count = 0;
+   switch ( pcode->opcode ) {
+   case PCD_GOTO:
+      count = add_edge( edges, count, cfg->block_of[ slot_of( cfg,
+         ( ( struct jump_pcode* ) pcode )->destination ) ] );
+      break;
+   case PCD_IFGOTO:
+   case PCD_IFNOTGOTO:
+      count = add_edge( edges, count, next );
+      count = add_edge( edges, count, cfg->block_of[ slot_of( cfg,
+         ( ( struct jump_pcode* ) pcode )->destination ) ] );
+      break;
+   case PCD_CASEGOTO:
+      count = add_edge( edges, count, next );
+      count = add_edge( edges, count, cfg->block_of[ slot_of( cfg,
+         ( ( struct casejump_pcode* ) pcode )->destination ) ] );
+      break;
+   case PCD_CASEGOTOSORTED: {
+         struct sortedcasejump_pcode* jump =
+            ( struct sortedcasejump_pcode* ) pcode;
+         count = add_edge( edges, count, next );
+         for ( i32 i = 0; i < jump->count; ++i ) {
+            count = add_edge( edges, count, cfg->block_of[ slot_of( cfg,
+               jump->cases[ i ].destination ) ] );
+         }
+      }
+      break;
+   case PCD_TERMINATE:
+   case PCD_RESTART:
+   case PCD_RETURNVOID:
+   case PCD_RETURNVAL:
+   // The destination of the jump is on the stack, so it is not known.
+   case PCD_GOTOSTACK:
+      break;
+   default:
+      count = add_edge( edges, count, next );
+   }
+   return count;
+}
+
+static u32 add_edge( u32* edges, u32 count, u32 block ) {
+   if ( edges ) {
+      edges[ count ] = block;
+   }
+   return count + 1;
+}
+
+static void add_predecessors( struct cfg* cfg ) {
+   for ( u32 i = 0; i < cfg->num_blocks; ++i ) {
+      struct cfg_block* block = &cfg->blocks[ i ];
+      for ( u32 k = 0; k < block->num_succs; ++k ) {
+         ++cfg->blocks[ cfg->succs[ block->first_succ + k ] ].num_preds;
+      }
+   }
+   u32 edge = 0;
+   for ( u32 i = 0; i < cfg->num_blocks; ++i ) {
+      cfg->blocks[ i ].first_pred = edge;
+      edge += cfg->blocks[ i ].num_preds;
+      cfg->blocks[ i ].num_preds = 0;
+   }
+   for ( u32 i = 0; i < cfg->num_blocks; ++i ) {
+      struct cfg_block* block = &cfg->blocks[ i ];
+      for ( u32 k = 0; k < block->num_succs; ++k ) {
+         struct cfg_block* succ =
+            &cfg->blocks[ cfg->succs[ block->first_succ + k ] ];
+         cfg->preds[ succ->first_pred + succ->num_preds ] = i;
+         ++succ->num_preds;
+      }
+   }
+}
+
+static void find_dominators( struct cfg* cfg ) {
+   u32* order = mem_alloc( sizeof( order[ 0 ] ) * cfg->num_blocks );
+   u32 num_reached = order_blocks( cfg, order );
+   cfg->blocks[ 0 ].dom.idom = 0;
+   bool changed = true;
+   while ( changed ) {
+      changed = false;
+      for ( u32 i = 1; i < num_reached; ++i ) {
+         struct cfg_block* block = &cfg->blocks[ order[ i ] ];
+         u32 idom = CFG_NO_BLOCK;
+         for ( u32 k = 0; k < block->num_preds; ++k ) {
+            u32 pred = cfg->preds[ block->first_pred + k ];
+            if ( cfg->blocks[ pred ].dom.idom != CFG_NO_BLOCK ) {
+               idom = ( idom == CFG_NO_BLOCK ) ? pred :
+                  intersect( cfg, idom, pred );
+            }
+         }
+         if ( block->dom.idom != idom ) {
+            block->dom.idom = idom;
+            changed = true;
+         }
+      }
+   }
+   number_tree( cfg, order, num_reached );
+   mem_free( order );
+}
+
+// Lists the blocks reachable from the entry in reverse postorder, and numbers
+// them in that order. Unreachable blocks keep CFG_NO_BLOCK as their number.
+static u32 order_blocks( struct cfg* cfg, u32* order ) {
+   for ( u32 i = 0; i < cfg->num_blocks; ++i ) {
+      struct cfg_dom_node* node = &cfg->blocks[ i ].dom;
+      node->idom = CFG_NO_BLOCK;
+      node->order = CFG_NO_BLOCK;
+      node->enter = 0;
+      node->leave = 0;
+   }
+   // The DFS stack holds a block and the number of its edges followed so far.
+   u32* stack = mem_alloc( sizeof( stack[ 0 ] ) * cfg->num_blocks * 2 );
+   u32 size = 0;
+   u32 num_finished = 0;
+   u32* postorder = mem_alloc( sizeof( postorder[ 0 ] ) * cfg->num_blocks );
+   cfg->blocks[ 0 ].dom.order = 0;
+   stack[ size++ ] = 0;
+   stack[ size++ ] = 0;
+   while ( size > 0 ) {
+      struct cfg_block* block = &cfg->blocks[ stack[ size - 2 ] ];
+      u32 edge = stack[ size - 1 ];
+      if ( edge < block->num_succs ) {
+         stack[ size - 1 ] = edge + 1;
+         u32 succ = cfg->succs[ block->first_succ + edge ];
+         struct cfg_dom_node* node = &cfg->blocks[ succ ].dom;
+         if ( node->order == CFG_NO_BLOCK ) {
+            // Marks the block as visited. The real number is given below.
+            node->order = 0;
+            stack[ size++ ] = succ;
+            stack[ size++ ] = 0;
+         }
+      }
+      else {
+         postorder[ num_finished++ ] = stack[ size - 2 ];
+         size -= 2;
+      }
+   }
+   for ( u32 i = 0; i < num_finished; ++i ) {
+      u32 block = postorder[ num_finished - 1 - i ];
+      order[ i ] = block;
+      cfg->blocks[ block ].dom.order = i;
+   }
+   mem_free( postorder );
+   mem_free( stack );
+   return num_finished;
+}
+
+static u32 intersect( struct cfg* cfg, u32 a, u32 b ) {
+   while ( a != b ) {
+      while ( cfg->blocks[ a ].dom.order > cfg->blocks[ b ].dom.order ) {
+         a = cfg->blocks[ a ].dom.idom;
+      }
+      while ( cfg->blocks[ b ].dom.order > cfg->blocks[ a ].dom.order ) {
+         b = cfg->blocks[ b ].dom.idom;
+      }
+   }
+   return a;
+}
+
+// Numbers the blocks in the order a walk of the tree enters and leaves them,
+// so whether a block dominates another is answered by comparing the numbers.
+static void number_tree( struct cfg* cfg, u32* order, u32 num_reached ) {
+   // The children of a block are listed next to each other, in the same way
+   // as the edges of the graph.
+   u32* first_child = mem_alloc( sizeof( first_child[ 0 ] ) *
+      ( cfg->num_blocks + 1 ) );
+   memset( first_child, 0, sizeof( first_child[ 0 ] ) *
+      ( cfg->num_blocks + 1 ) );
+   for ( u32 i = 1; i < num_reached; ++i ) {
+      ++first_child[ cfg->blocks[ order[ i ] ].dom.idom + 1 ];
+   }
+   for ( u32 i = 0; i < cfg->num_blocks; ++i ) {
+      first_child[ i + 1 ] += first_child[ i ];
+   }
+   u32* children = mem_alloc( sizeof( children[ 0 ] ) * ( num_reached + 1 ) );
+   u32* num_children = mem_alloc( sizeof( num_children[ 0 ] ) *
+      cfg->num_blocks );
+   memset( num_children, 0, sizeof( num_children[ 0 ] ) * cfg->num_blocks );
+   for ( u32 i = 1; i < num_reached; ++i ) {
+      u32 idom = cfg->blocks[ order[ i ] ].dom.idom;
+      children[ first_child[ idom ] + num_children[ idom ] ] = order[ i ];
+      ++num_children[ idom ];
+   }
+   u32* stack = mem_alloc( sizeof( stack[ 0 ] ) * ( num_reached + 1 ) * 2 );
+   u32 size = 0;
+   u32 clock = 0;
+   cfg->blocks[ 0 ].dom.enter = clock++;
+   stack[ size++ ] = 0;
+   stack[ size++ ] = 0;
+   while ( size > 0 ) {
+      u32 block = stack[ size - 2 ];
+      u32 child = stack[ size - 1 ];
+      if ( child < num_children[ block ] ) {
+         stack[ size - 1 ] = child + 1;
+         u32 next = children[ first_child[ block ] + child ];
+         cfg->blocks[ next ].dom.enter = clock++;
+         stack[ size++ ] = next;
+         stack[ size++ ] = 0;
+      }
+      else {
+         cfg->blocks[ block ].dom.leave = clock++;
+         size -= 2;
+      }
+   }
+   mem_free( stack );
+   mem_free( num_children );
+   mem_free( children );
+   mem_free( first_child );
+}
+
+static u32 block_of( struct cfg* cfg, struct pcode* pcode ) {
+   return cfg->block_of[ slot_of( cfg, pcode ) ];
+}
+
+static bool reachable( struct cfg* cfg, u32 block ) {
+   return ( cfg->blocks[ block ].dom.order != CFG_NO_BLOCK );
+}
+
+// Tells whether every path from the start of the body to the second block
+// goes through the first block.
+static bool dominates( struct cfg* cfg, u32 a, u32 b ) {
+   struct cfg_dom_node* node_a = &cfg->blocks[ a ].dom;
+   struct cfg_dom_node* node_b = &cfg->blocks[ b ].dom;
+   return ( reachable( cfg, a ) && reachable( cfg, b ) &&
+      node_a->enter <= node_b->enter && node_b->leave <= node_a->leave );
+}
+
+/**
+ * Tells whether a jump goes back to the header of a loop that contains the
+ * jump. Unreachable code has no dominators, so a jump in unreachable code is
+ * taken to close a loop when it goes backward.
+ */
+bool t_cfg_closes_loop( struct cfg* cfg, struct pcode* jump,
+   struct pcode* destination ) {
+   if ( ! reachable( cfg, block_of( cfg, jump ) ) ) {
+      return ( destination->obj_pos <= jump->obj_pos );
+   }
+   return dominates( cfg, block_of( cfg, destination ),
+      block_of( cfg, jump ) );
+}
@@ -17,11 +17,18 @@ struct codegen {
    i32 indent_level;
    bool got_newline;
    FILE* output;
+   // When not NULL, the output is collected here instead of being written to
+   // the output file.
+   struct str* capture;
 };
 
 static void init_codegen( struct codegen* codegen, struct task* task );
 static void open_output_file( struct codegen* codegen );
+static void close_output_file( struct codegen* codegen );
 static void write( struct codegen* codegen, const char* format, ... );
+static void append( struct codegen* codegen, const char* format, ... );
+static void append_args( struct codegen* codegen, const char* format,
+   va_list* args );
 static void emit( struct codegen* codegen );
 static void write_dircs( struct codegen* codegen );
 static void write_global_vars( struct codegen* codegen );
@@ -30,6 +37,11 @@ static void visit_var_dec( struct codegen* codegen, struct var* var );
 static void write_value( struct codegen* codegen, i32 type, i32 value );
 static void write_map_vars( struct codegen* codegen );
 static void write_objects( struct codegen* codegen );
+static bool object_selected( struct node* node );
+static struct cached_body* get_cached_body( struct node* node );
+static void write_object( struct codegen* codegen, struct node* node );
+static void write_cached_object( struct codegen* codegen, struct node* node,
+   struct cached_body* body );
 static void show_script( struct codegen* codegen, struct script* script );
 static void write_func( struct codegen* codegen, struct func* func );
 static void emit_block( struct codegen* codegen, struct block* block );
@@ -87,7 +99,7 @@ void t_publish( struct task* task ) {
    init_codegen( &codegen, task );
    open_output_file( &codegen );
    emit( &codegen );
-   //close_output_file( &codegen );
+   close_output_file( &codegen );
 }
 
 static void init_codegen( struct codegen* codegen, struct task* task ) {
@@ -95,11 +107,12 @@ static void init_codegen( struct codegen* codegen, struct task* task ) {
    codegen->indent_level = 0;
    codegen->got_newline = false;
    codegen->output = stdout;
+   codegen->capture = NULL;
 }
 
 static void open_output_file( struct codegen* codegen ) {
-   if ( codegen->task->options->source_file ) {
-      FILE* fh = fopen( codegen->task->options->source_file, "w" );
+   if ( codegen->task->input.output_file ) {
+      FILE* fh = fopen( codegen->task->input.output_file, "w" );
       if ( ! fh ) {
          printf( "error: failed to open output file\n" );
          exit( EXIT_FAILURE );
@@ -109,26 +122,50 @@ static void open_output_file( struct codegen* codegen ) {
    //printf( "%s\n", codegen->task->options->source_file );
 }
 
+static void close_output_file( struct codegen* codegen ) {
+   if ( codegen->output != stdout ) {
+      fclose( codegen->output );
+      codegen->output = stdout;
+   }
+}
+
 void write( struct codegen* codegen, const char* format, ... ) {
    if ( codegen->got_newline ) {
       enum { INDENT_WIDTH = 3 }; // Amount of spaces.
       i32 num_spaces = codegen->indent_level * INDENT_WIDTH;
       for ( i32 i = 0; i < num_spaces; ++i ) {
-         fprintf( codegen->output, " " );
+         append( codegen, " " );
       }
    }
    va_list args;
    va_start( args, format );
-   vfprintf( codegen->output, format, args );
+   append_args( codegen, format, &args );
    va_end( args );
    codegen->got_newline = false;
 }
 
 void write_nl( struct codegen* codegen ) {
-   fprintf( codegen->output, "\n" );
+   append( codegen, "\n" );
    codegen->got_newline = true;
 }
 
+static void append( struct codegen* codegen, const char* format, ... ) {
+   va_list args;
+   va_start( args, format );
+   append_args( codegen, format, &args );
+   va_end( args );
+}
+
+static void append_args( struct codegen* codegen, const char* format,
+   va_list* args ) {
+   if ( codegen->capture ) {
+      str_append_format( codegen->capture, format, args );
+   }
+   else {
+      vfprintf( codegen->output, format, *args );
+   }
+}
+
 void indent( struct codegen* codegen ) {
    ++codegen->indent_level;
 }
@@ -160,7 +197,7 @@ static void write_dircs( struct codegen* codegen ) {
       // need to explicitly specify it. There is also no need to specify the
       // directive when there are no scripts.
       if ( ! codegen->task->importable &&
-         list_size( &codegen->task->scripts ) > 0 ) {
+         vec_size( &codegen->task->scripts ) > 0 ) {
          write( codegen, "#nowadauthor" );
          write_nl( codegen );
       }
@@ -180,7 +217,7 @@ static void write_dircs( struct codegen* codegen ) {
    list_iterate( &codegen->task->imports, &i );
    while ( ! list_end( &i ) ) {
       struct imported_module* module = list_data( &i );
-      write( codegen, "#import \"%s.acs\"", module->name.value );
+      write( codegen, "#import \"%s.acs\"", module->name->value );
       write_nl( codegen );
       list_next( &i );
    }
@@ -344,35 +381,87 @@ static void write_map_vars( struct codegen* codegen ) {
    }
 }
 
+// Scripts and functions that were not selected are left out.
 static void write_objects( struct codegen* codegen ) {
-   struct list_iter i;
-   list_iterate( &codegen->task->objects, &i );
-   while ( ! list_end( &i ) ) {
-      struct node* node = list_data( &i );
-      switch ( node->type ) {
-      case NODE_SCRIPT:
-         show_script( codegen,
-            ( struct script* ) node );
-         break;
-      case NODE_FUNC:
-         write_func( codegen,
-            ( struct func* ) node );
-         break;
-      default:
-         UNREACHABLE();
-         t_bail( codegen->task );
+   bool written = false;
+   for ( u32 i = 0; i < vec_size( &codegen->task->objects ); ++i ) {
+      struct node* node = vec_at( &codegen->task->objects, i );
+      if ( ! object_selected( node ) ) {
+         continue;
       }
-      list_next( &i );
-      if ( ! list_end( &i ) ) {
+      if ( written ) {
          write_nl( codegen );
       }
+      struct cached_body* body = get_cached_body( node );
+      if ( body->text ) {
+         append( codegen, "%s", body->text );
+         codegen->got_newline = true;
+      }
+      else if ( body->reusable && codegen->task->num_diags == 0 ) {
+         write_cached_object( codegen, node, body );
+      }
+      else {
+         write_object( codegen, node );
+      }
+      written = true;
    }
 }
 
+static bool object_selected( struct node* node ) {
+   switch ( node->type ) {
+   case NODE_SCRIPT:
+      return ( ( struct script* ) node )->selected;
+   case NODE_FUNC:
+      return ( ( struct func* ) node )->more.user->selected;
+   default:
+      return true;
+   }
+}
+
+static struct cached_body* get_cached_body( struct node* node ) {
+   if ( node->type == NODE_SCRIPT ) {
+      return &( ( struct script* ) node )->cache;
+   }
+   else {
+      return &( ( struct func* ) node )->more.user->cache;
+   }
+}
+
+static void write_object( struct codegen* codegen, struct node* node ) {
+   switch ( node->type ) {
+   case NODE_SCRIPT:
+      show_script( codegen,
+         ( struct script* ) node );
+      break;
+   case NODE_FUNC:
+      write_func( codegen,
+         ( struct func* ) node );
+      break;
+   default:
+      UNREACHABLE();
+      t_bail( codegen->task );
+   }
+}
+
+// The source code of the object is collected first, so it can be stored in the
+// body cache. The source code always ends with a newline, so the object is
+// written the same way when its source code is taken from the cache.
+static void write_cached_object( struct codegen* codegen, struct node* node,
+   struct cached_body* body ) {
+   struct str text;
+   str_init( &text );
+   codegen->capture = &text;
+   write_object( codegen, node );
+   codegen->capture = NULL;
+   t_store_cached_body( codegen->task, body, text.value );
+   append( codegen, "%s", text.value );
+   str_deinit( &text );
+}
+
 static void show_script( struct codegen* codegen, struct script* script ) {
    write( codegen, "script " );
    if ( script->named_script ) {
-      write( codegen, "\"%s\" ", script->name.value );
+      write( codegen, "\"%s\" ", script->name->value );
    }
    else {
       write( codegen, "%d ", script->number );
@@ -439,8 +528,8 @@ static void write_func( struct codegen* codegen, struct func* func ) {
    write( codegen, " %s", name );
    // Function name.
    write( codegen, " " );
-   if ( func->name.length > 0 ) {
-      write( codegen, func->name.value );
+   if ( func->name && func->name->length > 0 ) {
+      write( codegen, func->name->value );
    }
    else {
       write( codegen, "Func%d", func->more.user->index );
@@ -468,14 +557,11 @@ static void write_func( struct codegen* codegen, struct func* func ) {
 static void emit_block( struct codegen* codegen, struct block* block ) {
    write( codegen, "{" );
    indent( codegen );
-   if ( list_size( &block->stmts ) > 0 ) {
+   if ( vec_size( &block->stmts ) > 0 ) {
       write_nl( codegen );
-      struct list_iter i;
-      list_iterate( &block->stmts, &i );
-      while ( ! list_end( &i ) ) {
-         struct node* node = list_data( &i );
+      for ( u32 i = 0; i < vec_size( &block->stmts ); ++i ) {
+         struct node* node = vec_at( &block->stmts, i );
          visit_stmt( codegen, node );
-         list_next( &i );
       }
    }
    dedent( codegen );
@@ -553,8 +639,8 @@ static void emit_if( struct codegen* codegen, struct if_stmt* stmt ) {
    emit_block( codegen, stmt->body );
    if ( stmt->else_body ) {
       struct if_stmt* else_if = NULL;
-      if ( list_size( &stmt->else_body->stmts ) == 1 ) {
-         struct node* node = list_head( &stmt->else_body->stmts );
+      if ( vec_size( &stmt->else_body->stmts ) == 1 ) {
+         struct node* node = vec_head( &stmt->else_body->stmts );
          if ( node->type == NODE_IF ) {
             else_if = ( struct if_stmt* ) node;
          }
@@ -615,12 +701,9 @@ static void visit_for( struct codegen* codegen, struct for_stmt* stmt ) {
    write( codegen, "for ( ; " );
    emit_expr( codegen, stmt->cond );
    write( codegen, "; " );
-   struct list_iter i;
-   list_iterate( &stmt->post, &i );
-   while ( ! list_end( &i ) ) {
-      emit_expr( codegen, list_data( &i ) );
-      list_next( &i );
-      if ( ! list_end( &i ) ) {
+   for ( u32 i = 0; i < vec_size( &stmt->post ); ++i ) {
+      emit_expr( codegen, vec_at( &stmt->post, i ) );
+      if ( i + 1 < vec_size( &stmt->post ) ) {
          write( codegen, ", " );
       }
    }
@@ -669,7 +752,7 @@ static void visit_return( struct codegen* codegen, struct return_stmt* stmt ) {
 
 static void emit_inline_asm( struct codegen* codegen,
    struct inline_asm* inline_asm ) {
-   write( codegen, "// > %d", inline_asm->pcode->opcode );
+   write( codegen, "// > %d", inline_asm->opcode );
    write_nl( codegen );
 }
 
@@ -995,8 +1078,8 @@ static void emit_aspec( struct codegen* codegen, struct aspec* aspec ) {
 
 static void emit_func( struct codegen* codegen, struct func* func ) {
    // Name.
-   if ( func->name.length > 0 ) {
-      write( codegen, func->name.value );
+   if ( func->name && func->name->length > 0 ) {
+      write( codegen, func->name->value );
    }
    else {
       switch ( func->type ) {
@@ -1014,8 +1097,8 @@ static void emit_var( struct codegen* codegen, struct var* var ) {
 }
 
 static void write_var_name( struct codegen* codegen, struct var* var ) {
-   if ( var->name.length > 0 ) {
-      write( codegen, "%s", var->name.value );
+   if ( var->name && var->name->length > 0 ) {
+      write( codegen, "%s", var->name->value );
    }
    else {
       const char* storage = "";
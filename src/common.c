@@ -9,152 +9,423 @@
 // NOTE: The functions below may be violating the strict-aliasing rule.
 // ==========================================================================
 
-// Linked list of current allocations. The head is the most recent allocation.
-// This way, a short-term allocation can be found and removed quicker.
-static struct alloc {
-   struct alloc* next;
-}* g_alloc = NULL;
-// Allocation sizes for bulk allocation.
-static struct {
-   size_t size;
-   size_t quantity;
-} g_bulk_sizes[] = {
-   { 8, 128 },
-   { sizeof( struct list_link ), 128 },
-};
-// Bulk allocations.
-static struct {
+// Every block handed out by an arena is preceded by a header that records the
+// size of the block. The header of a large block also points to the separate
+// allocation that holds it.
+union mem_header {
    struct {
       size_t size;
-      size_t quantity;
-      size_t left;
-      char* block;
-      struct free_block {
-         struct free_block* next;
-      }* free_block;
-   } slots[ ARRAY_SIZE( g_bulk_sizes ) ];
-   size_t slots_used;
-} g_bulk;
-
-static void unlink_alloc( struct alloc* );
-
-void mem_init( void ) {
-   g_bulk.slots_used = 0;
-   size_t i = 0;
-   while ( i < ARRAY_SIZE( g_bulk_sizes ) ) {
-      // Find slot with specified allocation size.
-      size_t k = 0;
-      while ( k < g_bulk.slots_used &&
-         g_bulk.slots[ k ].size != g_bulk_sizes[ i ].size ) {
-         ++k;
-      }
-      // If slot doesn't exist, allocate one.
-      if ( k == g_bulk.slots_used ) {
-         g_bulk.slots[ k ].size = g_bulk_sizes[ i ].size;
-         g_bulk.slots[ k ].quantity = g_bulk_sizes[ i ].quantity;
-         g_bulk.slots[ k ].left = 0;
-         g_bulk.slots[ k ].block = NULL;
-         g_bulk.slots[ k ].free_block = NULL;
-         ++g_bulk.slots_used;
+      struct mem_large* large;
+   } info;
+   char padding[ MEM_ALIGN ];
+};
+STATIC_ASSERT( sizeof( union mem_header ) == MEM_ALIGN, bad_mem_header );
+// Chunks are never freed individually, so a singly linked list is enough.
+struct mem_chunk {
+   struct mem_chunk* next;
+};
+union mem_chunk_header {
+   struct mem_chunk chunk;
+   char padding[ MEM_ALIGN ];
+};
+// Blocks too large to fit comfortably in a chunk get their own allocation.
+// These can be freed or resized individually, so they are doubly linked.
+struct mem_large {
+   struct mem_arena* arena;
+   struct mem_large* prev;
+   struct mem_large* next;
+};
+union mem_large_header {
+   struct mem_large large;
+   char padding[ MEM_ALIGN * 2 ];
+};
+// Arena used by the mem_*() functions. All other allocator state lives in the
+// arenas themselves, so threads that select different arenas share nothing.
+static THREAD_LOCAL struct mem_arena* g_arena = NULL;
+
+static void reset_arena( struct mem_arena* arena );
+static void* arena_alloc( struct mem_arena* arena, size_t size );
+static void* alloc_large( struct mem_arena* arena, size_t size );
+static void add_chunk( struct mem_arena* arena );
+static void* arena_realloc( struct mem_arena* arena, void* block,
+   size_t size );
+static void* realloc_large( void* block, size_t size );
+static void* slot_alloc( struct mem_arena* arena, size_t size,
+   enum mem_site site );
+static void arena_free( struct mem_arena* arena, void* block );
+static void slot_free( struct mem_arena* arena, void* block, size_t size,
+   enum mem_site site );
+static void unlink_large( struct mem_large* large );
+static struct mem_slab* get_slab( struct mem_arena* arena, size_t size );
+static size_t block_size( void* block );
+static void count_alloc( struct mem_arena* arena, enum mem_site site,
+   size_t size, bool reused );
+static void count_free( struct mem_arena* arena, enum mem_site site,
+   size_t size );
+static void count_resize( struct mem_arena* arena, enum mem_site site,
+   size_t old_size, size_t size );
+static void* alloc_system_block( size_t size );
+static size_t align_size( size_t size );
+
+void mem_arena_init( struct mem_arena* arena ) {
+   reset_arena( arena );
+   arena->stats = NULL;
+}
+
+static void reset_arena( struct mem_arena* arena ) {
+   arena->chunk = NULL;
+   arena->large = NULL;
+   arena->tip = NULL;
+   arena->end = NULL;
+   arena->last = NULL;
+   for ( size_t i = 0; i < ARRAY_SIZE( arena->slabs ); ++i ) {
+      arena->slabs[ i ].block = NULL;
+      arena->slabs[ i ].left = 0;
+      arena->slabs[ i ].free_block = NULL;
+   }
+   for ( size_t i = 0; i < ARRAY_SIZE( arena->live ); ++i ) {
+      arena->live[ i ] = 0;
+   }
+}
+
+// Releases every block of the arena. The cost depends on the number of chunks,
+// not on the number of allocations.
+void mem_arena_deinit( struct mem_arena* arena ) {
+   while ( arena->chunk ) {
+      struct mem_chunk* next = arena->chunk->next;
+      free( arena->chunk );
+      arena->chunk = next;
+   }
+   while ( arena->large ) {
+      struct mem_large* next = arena->large->next;
+      free( arena->large );
+      arena->large = next;
+   }
+   for ( size_t i = 0; i < ARRAY_SIZE( arena->live ); ++i ) {
+      count_free( arena, ( enum mem_site ) i, arena->live[ i ] );
+   }
+   reset_arena( arena );
+}
+
+// Makes the mem_*() functions of the calling thread allocate from the
+// specified arena. Returns the previously selected arena.
+struct mem_arena* mem_select_arena( struct mem_arena* arena ) {
+   struct mem_arena* prev_arena = g_arena;
+   g_arena = arena;
+   return prev_arena;
+}
+
+void mem_stats_init( struct mem_stats* stats ) {
+   struct mem_site_stats empty = { 0, 0, 0, 0, 0 };
+   for ( size_t i = 0; i < MEM_SITE_TOTAL; ++i ) {
+      stats->sites[ i ] = empty;
+      for ( size_t k = 0; k < MEM_MAX_PHASES; ++k ) {
+         stats->phases[ k ][ i ] = empty;
       }
-      else {
-         // On duplicate allocation size, use higher quantity.
-         if ( g_bulk.slots[ k ].quantity < g_bulk_sizes[ i ].quantity ) {
-            g_bulk.slots[ k ].quantity = g_bulk_sizes[ i ].quantity;
-         }
+   }
+   stats->phase = 0;
+}
+
+// Starts counting allocations for the specified phase. The peak of the phase
+// starts out at what is already live.
+void mem_stats_set_phase( struct mem_stats* stats, i32 phase ) {
+   stats->phase = phase;
+   for ( size_t i = 0; i < MEM_SITE_TOTAL; ++i ) {
+      if ( stats->sites[ i ].live > stats->phases[ phase ][ i ].peak ) {
+         stats->phases[ phase ][ i ].peak = stats->sites[ i ].live;
       }
-      ++i;
    }
 }
 
+// Makes the arena count its allocations in the specified statistics.
+void mem_arena_track( struct mem_arena* arena, struct mem_stats* stats ) {
+   arena->stats = stats;
+}
+
 void* mem_alloc( size_t size ) {
-   return mem_realloc( NULL, size );
+   void* block = arena_alloc( g_arena, size );
+   count_alloc( g_arena, MEM_SITE_ALLOC, size, false );
+   return block;
 }
 
-void* mem_realloc( void* block, size_t size ) {
-   struct alloc* alloc = NULL;
-   if ( block ) {
-      alloc = ( struct alloc* ) block - 1;
-      unlink_alloc( alloc );
+static void* arena_alloc( struct mem_arena* arena, size_t size ) {
+   size_t block_size = sizeof( union mem_header ) + align_size( size );
+   if ( block_size > MEM_LARGE_SIZE ) {
+      return alloc_large( arena, size );
    }
-   alloc = realloc( alloc, sizeof( *alloc ) + size );
-   if ( ! alloc ) {
-      mem_free_all();
-      printf( "error: failed to allocate memory block of %zu bytes\n", size );
-      exit( EXIT_FAILURE );
+   if ( block_size > ( size_t ) ( arena->end - arena->tip ) ) {
+      add_chunk( arena );
    }
-   alloc->next = g_alloc;
-   g_alloc = alloc;
-   return alloc + 1;
+   union mem_header* header = ( union mem_header* ) arena->tip;
+   header->info.size = size;
+   header->info.large = NULL;
+   arena->tip += block_size;
+   arena->last = header + 1;
+   return header + 1;
+}
+
+static void* alloc_large( struct mem_arena* arena, size_t size ) {
+   union mem_large_header* large = alloc_system_block(
+      sizeof( *large ) + sizeof( union mem_header ) + size );
+   large->large.arena = arena;
+   large->large.prev = NULL;
+   large->large.next = arena->large;
+   if ( arena->large ) {
+      arena->large->prev = &large->large;
+   }
+   arena->large = &large->large;
+   union mem_header* header = ( union mem_header* ) ( large + 1 );
+   header->info.size = size;
+   header->info.large = &large->large;
+   return header + 1;
+}
+
+// Starts a new chunk. Whatever is left of the current chunk is abandoned.
+static void add_chunk( struct mem_arena* arena ) {
+   union mem_chunk_header* chunk = alloc_system_block( MEM_CHUNK_SIZE );
+   chunk->chunk.next = arena->chunk;
+   arena->chunk = &chunk->chunk;
+   arena->tip = ( char* ) ( chunk + 1 );
+   arena->end = ( char* ) chunk + MEM_CHUNK_SIZE;
+   arena->last = NULL;
+}
+
+void* mem_realloc( void* block, size_t size ) {
+   size_t old_size = block_size( block );
+   block = arena_realloc( g_arena, block, size );
+   count_resize( g_arena, MEM_SITE_ALLOC, old_size, size );
+   return block;
 }
 
-void unlink_alloc( struct alloc* alloc ) {
-   struct alloc* curr = g_alloc;
-   struct alloc* prev = NULL;
-   while ( curr != alloc ) {
-      prev = curr;
-      curr = curr->next;
+static void* arena_realloc( struct mem_arena* arena, void* block,
+   size_t size ) {
+   if ( ! block ) {
+      return arena_alloc( arena, size );
    }
+   union mem_header* header = ( union mem_header* ) block - 1;
+   if ( header->info.large ) {
+      return realloc_large( block, size );
+   }
+   // The most recent allocation sits at the tip of the arena, so it can be
+   // resized without moving it.
+   if ( block == arena->last ) {
+      char* tip = ( char* ) block + align_size( size );
+      if ( tip <= arena->end ) {
+         header->info.size = size;
+         arena->tip = tip;
+         return block;
+      }
+   }
+   else if ( size <= header->info.size ) {
+      return block;
+   }
+   void* new_block = arena_alloc( arena, size );
+   memcpy( new_block, block, header->info.size < size ?
+      header->info.size : size );
+   arena_free( arena, block );
+   return new_block;
+}
+
+// A large block is relinked into the arena it was allocated from, which is not
+// necessarily the selected arena.
+static void* realloc_large( void* block, size_t size ) {
+   union mem_header* header = ( union mem_header* ) block - 1;
+   struct mem_arena* arena = header->info.large->arena;
+   struct mem_large* prev = header->info.large->prev;
+   struct mem_large* next = header->info.large->next;
+   union mem_large_header* large = realloc( header->info.large,
+      sizeof( *large ) + sizeof( union mem_header ) + size );
+   if ( ! large ) {
+      printf( "error: failed to allocate memory block of %zu bytes\n", size );
+      exit( EXIT_FAILURE );
+   }
+   // The block might have moved, so the neighbors need to be relinked.
    if ( prev ) {
-      prev->next = alloc->next;
+      prev->next = &large->large;
    }
    else {
-      g_alloc = alloc->next;
+      arena->large = &large->large;
+   }
+   if ( next ) {
+      next->prev = &large->large;
    }
+   header = ( union mem_header* ) ( large + 1 );
+   header->info.size = size;
+   header->info.large = &large->large;
+   return header + 1;
 }
 
 void* mem_slot_alloc( size_t size ) {
-   size_t i = 0;
-   while ( i < g_bulk.slots_used ) {
-      if ( g_bulk.slots[ i ].size == size ) {
-         // Reuse a previously allocated block.
-         if ( g_bulk.slots[ i ].free_block ) {
-            struct free_block* free_block = g_bulk.slots[ i ].free_block;
-            g_bulk.slots[ i ].free_block = free_block->next;
-            return free_block;
-         }
-         // When no more blocks are left, allocate a series of blocks in a
-         // single allocation.
-         if ( ! g_bulk.slots[ i ].left ) {
-            g_bulk.slots[ i ].left = g_bulk.slots[ i ].quantity;
-            g_bulk.slots[ i ].block = mem_alloc( g_bulk.slots[ i ].size *
-               g_bulk.slots[ i ].quantity );
-         }
-         char* block = g_bulk.slots[ i ].block;
-         g_bulk.slots[ i ].block += g_bulk.slots[ i ].size;
-         --g_bulk.slots[ i ].left;
-         return block;
-      }
-      ++i;
+   return slot_alloc( g_arena, size, MEM_SITE_SLOT );
+}
+
+static void* slot_alloc( struct mem_arena* arena, size_t size,
+   enum mem_site site ) {
+   struct mem_slab* slab = get_slab( arena, size );
+   if ( ! slab ) {
+      count_alloc( arena, site, size, false );
+      return arena_alloc( arena, size );
+   }
+   size_t slot_size = ( size_t ) ( slab - arena->slabs + 1 ) *
+      MEM_SLOT_GRANULARITY;
+   // Reuse a previously allocated block.
+   if ( slab->free_block ) {
+      struct mem_free_block* free_block = slab->free_block;
+      slab->free_block = free_block->next;
+      count_alloc( arena, site, slot_size, true );
+      return free_block;
+   }
+   // When no more blocks are left, allocate a series of blocks in a single
+   // allocation.
+   if ( ! slab->left ) {
+      slab->left = MEM_SLAB_SIZE / slot_size;
+      slab->block = arena_alloc( arena, slot_size * slab->left );
    }
-   return mem_alloc( size );
+   char* block = slab->block;
+   slab->block += slot_size;
+   --slab->left;
+   count_alloc( arena, site, slot_size, false );
+   return block;
+}
+
+// Returns the slab of the size class that fits the specified size, or NULL
+// when the size is too large to be pooled.
+static struct mem_slab* get_slab( struct mem_arena* arena, size_t size ) {
+   if ( size > MEM_MAX_SLOT_SIZE ) {
+      return NULL;
+   }
+   if ( size < sizeof( struct mem_free_block ) ) {
+      size = sizeof( struct mem_free_block );
+   }
+   return &arena->slabs[ ( size - 1 ) / MEM_SLOT_GRANULARITY ];
 }
 
 void mem_free( void* block ) {
-   struct alloc* alloc = ( struct alloc* ) block - 1;
-   unlink_alloc( alloc );
-   free( alloc );
+   count_free( g_arena, MEM_SITE_ALLOC, block_size( block ) );
+   arena_free( g_arena, block );
+}
+
+// Only the most recent allocation and large blocks are given back right away.
+// The memory of any other block is reclaimed when the arena is released.
+static void arena_free( struct mem_arena* arena, void* block ) {
+   union mem_header* header = ( union mem_header* ) block - 1;
+   if ( header->info.large ) {
+      unlink_large( header->info.large );
+      free( header->info.large );
+   }
+   else if ( block == arena->last ) {
+      arena->tip = ( char* ) header;
+      arena->last = NULL;
+   }
+}
+
+static void unlink_large( struct mem_large* large ) {
+   if ( large->prev ) {
+      large->prev->next = large->next;
+   }
+   else {
+      large->arena->large = large->next;
+   }
+   if ( large->next ) {
+      large->next->prev = large->prev;
+   }
 }
 
 void mem_slot_free( void* block, size_t size ) {
-   size_t i = 0;
-   while ( i < g_bulk.slots_used ) {
-      if ( g_bulk.slots[ i ].size == size ) {
-         struct free_block* free_block = block;
-         free_block->next = g_bulk.slots[ i ].free_block;
-         g_bulk.slots[ i ].free_block = free_block;
-         return;
-      }
-      ++i;
+   slot_free( g_arena, block, size, MEM_SITE_SLOT );
+}
+
+static void slot_free( struct mem_arena* arena, void* block, size_t size,
+   enum mem_site site ) {
+   struct mem_slab* slab = get_slab( arena, size );
+   if ( slab ) {
+      struct mem_free_block* free_block = block;
+      free_block->next = slab->free_block;
+      slab->free_block = free_block;
+      count_free( arena, site, ( size_t ) ( slab - arena->slabs + 1 ) *
+         MEM_SLOT_GRANULARITY );
+   }
+   else {
+      count_free( arena, site, size );
+      arena_free( arena, block );
    }
-   mem_free( block );
 }
 
-void mem_free_all( void ) {
-   while ( g_alloc ) {
-      struct alloc* next = g_alloc->next;
-      free( g_alloc );
-      g_alloc = next;
+// Allocates a block outside of any arena, for memory needed when no task is
+// running. The block is released with free(). Like the other allocation
+// functions, the program is exited when there is no memory left.
+void* mem_system_alloc( size_t size ) {
+   return alloc_system_block( size );
+}
+
+static void* alloc_system_block( size_t size ) {
+   void* block = malloc( size );
+   if ( ! block ) {
+      printf( "error: failed to allocate memory block of %zu bytes\n", size );
+      exit( EXIT_FAILURE );
+   }
+   return block;
+}
+
+static size_t align_size( size_t size ) {
+   return ( size + MEM_ALIGN - 1 ) & ~( size_t ) ( MEM_ALIGN - 1 );
+}
+
+static size_t block_size( void* block ) {
+   if ( block ) {
+      union mem_header* header = ( union mem_header* ) block - 1;
+      return header->info.size;
+   }
+   else {
+      return 0;
+   }
+}
+
+static void count_alloc( struct mem_arena* arena, enum mem_site site,
+   size_t size, bool reused ) {
+   if ( ! arena->stats ) {
+      return;
+   }
+   struct mem_site_stats* total = &arena->stats->sites[ site ];
+   struct mem_site_stats* phase =
+      &arena->stats->phases[ arena->stats->phase ][ site ];
+   ++total->calls;
+   ++phase->calls;
+   total->bytes += size;
+   phase->bytes += size;
+   if ( reused ) {
+      ++total->reused;
+      ++phase->reused;
+   }
+   arena->live[ site ] += size;
+   total->live += size;
+   if ( total->live > total->peak ) {
+      total->peak = total->live;
+   }
+   if ( total->live > phase->peak ) {
+      phase->peak = total->live;
+   }
+}
+
+static void count_free( struct mem_arena* arena, enum mem_site site,
+   size_t size ) {
+   if ( ! arena->stats ) {
+      return;
+   }
+   // A block can be freed while an arena other than its own is selected, so
+   // do not let the counters wrap around.
+   if ( size > arena->live[ site ] ) {
+      size = arena->live[ site ];
+   }
+   arena->live[ site ] -= size;
+   arena->stats->sites[ site ].live -= size;
+}
+
+static void count_resize( struct mem_arena* arena, enum mem_site site,
+   size_t old_size, size_t size ) {
+   if ( arena->stats ) {
+      count_free( arena, site, old_size );
+      count_alloc( arena, site, size, false );
    }
 }
 
@@ -171,7 +442,8 @@ void str_init( struct str* str ) {
 
 void str_deinit( struct str* str ) {
    if ( str->value ) {
-      mem_free( str->value );
+      count_free( g_arena, MEM_SITE_STR, block_size( str->value ) );
+      arena_free( g_arena, str->value );
    }
 }
 
@@ -197,7 +469,9 @@ void adjust_buffer( struct str* string, int length ) {
 }
 
 void str_grow( struct str* string, int length ) {
-   string->value = mem_realloc( string->value, ( size_t ) length );
+   size_t old_size = block_size( string->value );
+   string->value = arena_realloc( g_arena, string->value, ( size_t ) length );
+   count_resize( g_arena, MEM_SITE_STR, old_size, ( size_t ) length );
    string->buffer_length = length;
 }
 
@@ -228,11 +502,10 @@ void str_append_format( struct str* str, const char* format, va_list* args ) {
    va_copy( args_copy, *args );
    int length = vsnprintf( NULL, 0, format, *args );
    if ( length >= 0 ) {
-      if ( str->length + length >= str->buffer_length ) {
-         str_grow( str, str->length + length + 1 );
-      }
-      vsnprintf( str->value + str->length, ( size_t ) ( str->buffer_length - str->length ),
-         format, args_copy );
+      adjust_buffer( str, str->length + length );
+      vsnprintf( str->value + str->length, ( size_t ) length + 1, format,
+         args_copy );
+      str->length += length;
    }
    va_end( args_copy );
 }
@@ -244,6 +517,125 @@ void str_clear( struct str* str ) {
    }
 }
 
+// String table
+// ==========================================================================
+
+enum {
+   STR_TABLE_INITIAL_SLOTS = 64,
+   STR_TABLE_BLOCK_SIZE = 4096,
+};
+
+static u32 hash_str( const char* value, u32 length );
+static struct istr** find_slot( struct str_table* table, const char* value,
+   u32 length, u32 hash );
+static void grow_str_table( struct str_table* table );
+static struct istr* alloc_istr( struct str_table* table, u32 length );
+static void* alloc_str_table_block( struct str_table* table, size_t size );
+
+// The strings are allocated in the arena that is selected at the time the
+// table is initialized.
+void str_table_init( struct str_table* table ) {
+   table->arena = g_arena;
+   table->slots = NULL;
+   table->num_slots = 0;
+   table->count = 0;
+   table->block = NULL;
+   table->block_left = 0;
+}
+
+const struct istr* str_table_intern( struct str_table* table,
+   const char* value ) {
+   return str_table_intern_sub( table, value, ( u32 ) strlen( value ) );
+}
+
+// Returns the interned copy of the string, adding the string to the table if
+// it is not there yet. The returned string lives as long as the table's arena.
+const struct istr* str_table_intern_sub( struct str_table* table,
+   const char* value, u32 length ) {
+   // Keep the load factor at or below 3/4.
+   if ( ( table->count + 1 ) * 4 > table->num_slots * 3 ) {
+      grow_str_table( table );
+   }
+   u32 hash = hash_str( value, length );
+   struct istr** slot = find_slot( table, value, length, hash );
+   if ( ! *slot ) {
+      struct istr* string = alloc_istr( table, length );
+      string->id = table->count;
+      string->length = length;
+      string->hash = hash;
+      memcpy( string->value, value, length );
+      string->value[ length ] = '\0';
+      *slot = string;
+      ++table->count;
+   }
+   return *slot;
+}
+
+// FNV-1a.
+static u32 hash_str( const char* value, u32 length ) {
+   u32 hash = 2166136261u;
+   for ( u32 i = 0; i < length; ++i ) {
+      hash ^= ( u8 ) value[ i ];
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+static struct istr** find_slot( struct str_table* table, const char* value,
+   u32 length, u32 hash ) {
+   u32 mask = table->num_slots - 1;
+   u32 i = hash & mask;
+   while ( table->slots[ i ] && ! ( table->slots[ i ]->hash == hash &&
+      table->slots[ i ]->length == length &&
+      memcmp( table->slots[ i ]->value, value, length ) == 0 ) ) {
+      i = ( i + 1 ) & mask;
+   }
+   return &table->slots[ i ];
+}
+
+static void grow_str_table( struct str_table* table ) {
+   struct istr** slots = table->slots;
+   u32 num_slots = table->num_slots;
+   table->num_slots = num_slots ? num_slots * 2 : STR_TABLE_INITIAL_SLOTS;
+   table->slots = alloc_str_table_block( table,
+      sizeof( table->slots[ 0 ] ) * table->num_slots );
+   memset( table->slots, 0, sizeof( table->slots[ 0 ] ) * table->num_slots );
+   for ( u32 i = 0; i < num_slots; ++i ) {
+      if ( slots[ i ] ) {
+         *find_slot( table, slots[ i ]->value, slots[ i ]->length,
+            slots[ i ]->hash ) = slots[ i ];
+      }
+   }
+   if ( slots ) {
+      count_free( table->arena, MEM_SITE_STR, block_size( slots ) );
+      arena_free( table->arena, slots );
+   }
+}
+
+// Strings are packed back to back in blocks. A string too long for a block
+// gets an allocation of its own.
+static struct istr* alloc_istr( struct str_table* table, u32 length ) {
+   size_t size = sizeof( struct istr ) + length + 1;
+   size = ( size + sizeof( u32 ) - 1 ) & ~( sizeof( u32 ) - 1 );
+   if ( size > STR_TABLE_BLOCK_SIZE / 4 ) {
+      return alloc_str_table_block( table, size );
+   }
+   if ( size > table->block_left ) {
+      table->block = alloc_str_table_block( table, STR_TABLE_BLOCK_SIZE );
+      table->block_left = STR_TABLE_BLOCK_SIZE;
+   }
+   struct istr* string = ( struct istr* ) table->block;
+   table->block += size;
+   table->block_left -= size;
+   return string;
+}
+
+static void* alloc_str_table_block( struct str_table* table, size_t size ) {
+   void* block = arena_alloc( table->arena, size );
+   count_alloc( table->arena, MEM_SITE_STR, size, false );
+   return block;
+}
+
 // Singly linked list
 // ==========================================================================
 
@@ -280,7 +672,8 @@ void list_append( struct list* list, void* data ) {
 }
 
 static struct list_link* alloc_list_link( void* data ) {
-   struct list_link* link = mem_slot_alloc( sizeof( *link ) );
+   struct list_link* link = slot_alloc( g_arena, sizeof( *link ),
+      MEM_SITE_LIST );
    link->data = data;
    link->next = NULL;
    return link;
@@ -381,7 +774,7 @@ void* list_shift( struct list* list ) {
    if ( list->head ) {
       void* data = list->head->data;
       struct list_link* next_link = list->head->next;
-      mem_slot_free( list->head, sizeof( *list->head ) );
+      slot_free( g_arena, list->head, sizeof( *list->head ), MEM_SITE_LIST );
       list->head = next_link;
       if ( ! list->head ) {
          list->tail = NULL;
@@ -398,11 +791,87 @@ void list_deinit( struct list* list ) {
    struct list_link* link = list->head;
    while ( link ) {
       struct list_link* next = link->next;
-      mem_slot_free( link, sizeof( *link ) );
+      slot_free( g_arena, link, sizeof( *link ), MEM_SITE_LIST );
       link = next;
    }
 }
 
+// Vector
+// ==========================================================================
+
+static void grow_vec( struct vec* vec );
+
+void vec_init( struct vec* vec ) {
+   vec->items = NULL;
+   vec->size = 0;
+   vec->capacity = 0;
+}
+
+u32 vec_size( struct vec* vec ) {
+   return vec->size;
+}
+
+void* vec_at( struct vec* vec, u32 index ) {
+   return vec->items[ index ];
+}
+
+void* vec_head( struct vec* vec ) {
+   return vec->items[ 0 ];
+}
+
+void* vec_tail( struct vec* vec ) {
+   return vec->items[ vec->size - 1 ];
+}
+
+void vec_append( struct vec* vec, void* data ) {
+   if ( vec->size == vec->capacity ) {
+      grow_vec( vec );
+   }
+   vec->items[ vec->size ] = data;
+   ++vec->size;
+}
+
+// Doubles the capacity of the vector. As long as the vector is the most recent
+// allocation, the buffer is grown in place.
+static void grow_vec( struct vec* vec ) {
+   vec->capacity = vec->capacity ? vec->capacity * 2 : 8;
+   vec->items = mem_realloc( vec->items,
+      sizeof( vec->items[ 0 ] ) * vec->capacity );
+}
+
+void vec_insert( struct vec* vec, u32 index, void* data ) {
+   if ( vec->size == vec->capacity ) {
+      grow_vec( vec );
+   }
+   memmove( vec->items + index + 1, vec->items + index,
+      sizeof( vec->items[ 0 ] ) * ( vec->size - index ) );
+   vec->items[ index ] = data;
+   ++vec->size;
+}
+
+void* vec_replace( struct vec* vec, u32 index, void* data ) {
+   void* replaced_data = vec->items[ index ];
+   vec->items[ index ] = data;
+   return replaced_data;
+}
+
+void* vec_pop( struct vec* vec ) {
+   if ( vec->size > 0 ) {
+      --vec->size;
+      return vec->items[ vec->size ];
+   }
+   else {
+      return NULL;
+   }
+}
+
+void vec_deinit( struct vec* vec ) {
+   if ( vec->items ) {
+      mem_free( vec->items );
+   }
+   vec_init( vec );
+}
+
 // File Identity
 // ==========================================================================
 
@@ -470,6 +939,11 @@ int alignpad( int size, int align_size ) {
 
 #if OS_WINDOWS
 
+#include <io.h>
+#include <fcntl.h>
+#include <share.h>
+#include <sys/stat.h>
+
 bool c_read_full_path( const char* path, struct str* str ) {
    const int max_path = MAX_PATH + 1;
    if ( str->buffer_length < max_path ) { 
@@ -516,6 +990,51 @@ bool fs_create_dir( const char* path, struct fs_result* result ) {
    return ( CreateDirectory( path, NULL ) != 0 );
 }
 
+// The local application data directory of a user is only accessible to the
+// user, so a directory in it is private too.
+char* fs_get_cache_home( void ) {
+   const char* dir = getenv( "LOCALAPPDATA" );
+   if ( ! dir || ! c_is_absolute_path( dir ) ) {
+      return NULL;
+   }
+   char* path = mem_system_alloc( strlen( dir ) + 1 );
+   strcpy( path, dir );
+   return path;
+}
+
+bool fs_create_private_dir( const char* path, struct fs_result* result ) {
+   if ( CreateDirectory( path, NULL ) == 0 &&
+      GetLastError() != ERROR_ALREADY_EXISTS ) {
+      result->err = ENOENT;
+      return false;
+   }
+   struct fs_query query;
+   fs_init_query( &query, path );
+   if ( ! fs_is_dir( &query ) ) {
+      result->err = ENOTDIR;
+      return false;
+   }
+   result->err = 0;
+   return true;
+}
+
+FILE* fs_create_temp_file( char* path ) {
+   if ( _mktemp_s( path, strlen( path ) + 1 ) != 0 ) {
+      return NULL;
+   }
+   int fd = -1;
+   if ( _sopen_s( &fd, path, _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY,
+      _SH_DENYNO, _S_IREAD | _S_IWRITE ) != 0 ) {
+      return NULL;
+   }
+   FILE* fh = _fdopen( fd, "wb" );
+   if ( ! fh ) {
+      _close( fd );
+      DeleteFileA( path );
+   }
+   return fh;
+}
+
 void fs_init_query( struct fs_query* query, const char* path ) {
    query->path = path;
    query->err = 0;
@@ -656,6 +1175,63 @@ const char* fs_get_tempdir( void ) {
    return "/tmp";
 }
 
+// $XDG_CACHE_HOME, or ~/.cache when the variable is not set.
+char* fs_get_cache_home( void ) {
+   const char* dir = getenv( "XDG_CACHE_HOME" );
+   const char* subdir = "";
+   if ( ! dir || ! c_is_absolute_path( dir ) ) {
+      dir = getenv( "HOME" );
+      subdir = "/.cache";
+      if ( ! dir || ! c_is_absolute_path( dir ) ) {
+         return NULL;
+      }
+   }
+   size_t size = strlen( dir ) + strlen( subdir ) + 1;
+   char* path = mem_system_alloc( size );
+   snprintf( path, size, "%s%s", dir, subdir );
+   return path;
+}
+
+// A directory that already exists is used only when it is a real directory,
+// not a symbolic link, owned by the user, and inaccessible to anyone else.
+bool fs_create_private_dir( const char* path, struct fs_result* result ) {
+   if ( mkdir( path, S_IRWXU ) != 0 && errno != EEXIST ) {
+      result->err = errno;
+      return false;
+   }
+   struct stat info;
+   if ( lstat( path, &info ) != 0 ) {
+      result->err = errno;
+      return false;
+   }
+   if ( ! S_ISDIR( info.st_mode ) ) {
+      result->err = ENOTDIR;
+      return false;
+   }
+   if ( info.st_uid != geteuid() ||
+      ( info.st_mode & ( S_IRWXG | S_IRWXO ) ) != 0 ) {
+      result->err = EACCES;
+      return false;
+   }
+   result->err = 0;
+   return true;
+}
+
+// The path must end with "XXXXXX", which is replaced with the name of a file
+// that did not exist before.
+FILE* fs_create_temp_file( char* path ) {
+   int fd = mkstemp( path );
+   if ( fd == -1 ) {
+      return NULL;
+   }
+   FILE* fh = fdopen( fd, "wb" );
+   if ( ! fh ) {
+      close( fd );
+      unlink( path );
+   }
+   return fh;
+}
+
 bool fs_delete_file( const char* path ) {
    return ( unlink( path ) == 0 );
 }
@@ -696,3 +1272,179 @@ void fs_get_file_contents( const char* path, struct file_contents* contents ) {
    contents->obtained = true;
    contents->err = 0;
 }
+
+// Mapped Files
+// ==========================================================================
+
+static bool read_stream( FILE* fh, struct fs_mapped_file* file );
+
+#if OS_WINDOWS
+
+bool fs_map_file( const char* path, struct fs_mapped_file* file ) {
+   fs_init_mapped_file( file );
+   FILE* fh = fopen( path, "rb" );
+   if ( ! fh ) {
+      file->err = errno;
+      return false;
+   }
+   bool success = read_stream( fh, file );
+   fclose( fh );
+   return success;
+}
+
+void fs_unmap_file( struct fs_mapped_file* file ) {
+   free( ( void* ) file->data );
+   fs_init_mapped_file( file );
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+// Regular files are mapped into memory, so the file is read straight from the
+// page cache, without copying it. Anything that cannot be mapped, like a pipe,
+// is read instead.
+bool fs_map_file( const char* path, struct fs_mapped_file* file ) {
+   fs_init_mapped_file( file );
+   int fd = open( path, O_RDONLY );
+   if ( fd < 0 ) {
+      file->err = errno;
+      return false;
+   }
+   struct stat stat;
+   if ( fstat( fd, &stat ) == 0 && S_ISREG( stat.st_mode ) &&
+      stat.st_size > 0 ) {
+      void* data = mmap( NULL, ( size_t ) stat.st_size, PROT_READ, MAP_PRIVATE,
+         fd, 0 );
+      if ( data != MAP_FAILED ) {
+         close( fd );
+         file->data = data;
+         file->size = ( size_t ) stat.st_size;
+         file->mapped = true;
+         return true;
+      }
+   }
+   FILE* fh = fdopen( fd, "rb" );
+   if ( ! fh ) {
+      file->err = errno;
+      close( fd );
+      return false;
+   }
+   bool success = read_stream( fh, file );
+   fclose( fh );
+   return success;
+}
+
+void fs_unmap_file( struct fs_mapped_file* file ) {
+   if ( file->mapped ) {
+      munmap( ( void* ) file->data, file->size );
+   }
+   else {
+      free( ( void* ) file->data );
+   }
+   fs_init_mapped_file( file );
+}
+
+#endif
+
+void fs_init_mapped_file( struct fs_mapped_file* file ) {
+   file->data = NULL;
+   file->size = 0;
+   file->err = 0;
+   file->mapped = false;
+}
+
+// Reads until the end of the stream. The size of the stream is not known in
+// advance, so the buffer is grown as needed.
+static bool read_stream( FILE* fh, struct fs_mapped_file* file ) {
+   enum { INITIAL_BUFFER_SIZE = 64 * 1024 };
+   u8* data = NULL;
+   size_t capacity = 0;
+   size_t size = 0;
+   while ( true ) {
+      if ( size == capacity ) {
+         capacity = capacity ? capacity * 2 : INITIAL_BUFFER_SIZE;
+         u8* grown_data = realloc( data, capacity );
+         if ( ! grown_data ) {
+            file->err = ENOMEM;
+            free( data );
+            return false;
+         }
+         data = grown_data;
+      }
+      size_t num_read = fread( data + size, 1, capacity - size, fh );
+      size += num_read;
+      if ( num_read == 0 ) {
+         break;
+      }
+   }
+   if ( ferror( fh ) ) {
+      file->err = errno;
+      free( data );
+      return false;
+   }
+   file->data = data;
+   file->size = size;
+   return true;
+}
+
+// Threads
+// ==========================================================================
+
+#if OS_WINDOWS
+
+static DWORD WINAPI run_thread( LPVOID data );
+
+bool thread_start( struct thread* thread, void ( *start )( void* ),
+   void* data ) {
+   thread->start = start;
+   thread->data = data;
+   thread->handle = CreateThread( NULL, 0, run_thread, thread, 0, NULL );
+   return ( thread->handle != NULL );
+}
+
+static DWORD WINAPI run_thread( LPVOID data ) {
+   struct thread* thread = data;
+   thread->start( thread->data );
+   return 0;
+}
+
+void thread_join( struct thread* thread ) {
+   WaitForSingleObject( thread->handle, INFINITE );
+   CloseHandle( thread->handle );
+}
+
+u32 thread_count_cpus( void ) {
+   SYSTEM_INFO info;
+   GetSystemInfo( &info );
+   return ( u32 ) info.dwNumberOfProcessors;
+}
+
+#else
+
+static void* run_thread( void* data );
+
+bool thread_start( struct thread* thread, void ( *start )( void* ),
+   void* data ) {
+   thread->start = start;
+   thread->data = data;
+   return ( pthread_create( &thread->handle, NULL, run_thread, thread ) == 0 );
+}
+
+static void* run_thread( void* data ) {
+   struct thread* thread = data;
+   thread->start( thread->data );
+   return NULL;
+}
+
+void thread_join( struct thread* thread ) {
+   pthread_join( thread->handle, NULL );
+}
+
+u32 thread_count_cpus( void ) {
+   long count = sysconf( _SC_NPROCESSORS_ONLN );
+   return ( count > 0 ) ? ( u32 ) count : 1u;
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SRC_COMMON_H
 #define SRC_COMMON_H
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
@@ -12,14 +13,14 @@
 #   define OS_WINDOWS 0
 #endif
 
+#if defined( _MSC_VER )
+#   define THREAD_LOCAL __declspec( thread )
+#else
+#   define THREAD_LOCAL __thread
+#endif
+
 extern const char* c_version;
 
-void mem_init( void );
-void* mem_alloc( size_t );
-void* mem_realloc( void*, size_t );
-void* mem_slot_alloc( size_t );
-void mem_free( void* );
-void mem_free_all( void );
 
 #define ARRAY_SIZE( a ) ( sizeof( a ) / sizeof( a[ 0 ] ) )
 #define STATIC_ASSERT( ... ) \
@@ -46,6 +47,86 @@ typedef unsigned short u16;
 typedef unsigned int u32;
 typedef unsigned long long u64;
 
+// Memory
+// --------------------------------------------------------------------------
+
+enum {
+   MEM_ALIGN = 16,
+   MEM_CHUNK_SIZE = 64 * 1024,
+   MEM_LARGE_SIZE = MEM_CHUNK_SIZE / 8,
+   // Small fixed-size records are pooled in slabs. There is one slab for each
+   // size class, and the size classes are MEM_SLOT_GRANULARITY bytes apart.
+   MEM_SLAB_SIZE = 4096,
+   MEM_SLOT_GRANULARITY = 8,
+   MEM_NUM_SIZE_CLASSES = 32,
+   MEM_MAX_SLOT_SIZE = MEM_SLOT_GRANULARITY * MEM_NUM_SIZE_CLASSES
+};
+
+// Places that allocation statistics are gathered for.
+enum mem_site {
+   MEM_SITE_ALLOC,
+   MEM_SITE_SLOT,
+   MEM_SITE_STR,
+   MEM_SITE_LIST,
+   MEM_SITE_TOTAL
+};
+
+enum { MEM_MAX_PHASES = 8 };
+
+struct mem_site_stats {
+   size_t calls;
+   size_t bytes;
+   size_t live;
+   size_t peak;
+   // Number of allocations satisfied from a freelist.
+   size_t reused;
+};
+
+// Allocation counters shared by one or more arenas. The counters are also
+// kept separately for each phase, selected by the user of the arenas.
+struct mem_stats {
+   struct mem_site_stats sites[ MEM_SITE_TOTAL ];
+   struct mem_site_stats phases[ MEM_MAX_PHASES ][ MEM_SITE_TOTAL ];
+   i32 phase;
+};
+
+struct mem_chunk;
+struct mem_large;
+struct mem_free_block {
+   struct mem_free_block* next;
+};
+
+// Bump-pointer allocator. Blocks are carved out of large chunks and released
+// all at once when the arena is deinitialized.
+struct mem_arena {
+   struct mem_chunk* chunk;
+   struct mem_large* large;
+   char* tip;
+   char* end;
+   void* last;
+   struct mem_slab {
+      char* block;
+      size_t left;
+      struct mem_free_block* free_block;
+   } slabs[ MEM_NUM_SIZE_CLASSES ];
+   // NULL when the arena is not tracked.
+   struct mem_stats* stats;
+   size_t live[ MEM_SITE_TOTAL ];
+};
+
+void mem_arena_init( struct mem_arena* arena );
+void mem_arena_deinit( struct mem_arena* arena );
+struct mem_arena* mem_select_arena( struct mem_arena* arena );
+void mem_stats_init( struct mem_stats* stats );
+void mem_stats_set_phase( struct mem_stats* stats, i32 phase );
+void mem_arena_track( struct mem_arena* arena, struct mem_stats* stats );
+void* mem_alloc( size_t );
+void* mem_realloc( void*, size_t );
+void* mem_slot_alloc( size_t );
+void mem_free( void* );
+void mem_slot_free( void* block, size_t size );
+void* mem_system_alloc( size_t size );
+
 struct str {
    char* value;
    i32 length;
@@ -62,6 +143,33 @@ void str_append_number( struct str*, i32 number );
 void str_append_format( struct str* str, const char* format, va_list* args );
 void str_clear( struct str* );
 
+// String table
+// --------------------------------------------------------------------------
+
+// A string stored in a string table. The table keeps one copy of each distinct
+// string, so two interned strings are equal only if they are the same object.
+struct istr {
+   u32 id;
+   u32 length;
+   u32 hash;
+   char value[];
+};
+
+struct str_table {
+   struct mem_arena* arena;
+   struct istr** slots;
+   u32 num_slots;
+   u32 count;
+   char* block;
+   size_t block_left;
+};
+
+void str_table_init( struct str_table* table );
+const struct istr* str_table_intern( struct str_table* table,
+   const char* value );
+const struct istr* str_table_intern_sub( struct str_table* table,
+   const char* value, u32 length );
+
 // Singly linked list
 // --------------------------------------------------------------------------
 
@@ -101,6 +209,26 @@ void list_merge( struct list* receiver, struct list* giver );
 void* list_shift( struct list* list );
 void list_deinit( struct list* list );
 
+// Vector
+// --------------------------------------------------------------------------
+
+struct vec {
+   void** items;
+   u32 size;
+   u32 capacity;
+};
+
+void vec_init( struct vec* vec );
+u32 vec_size( struct vec* vec );
+void* vec_at( struct vec* vec, u32 index );
+void* vec_head( struct vec* vec );
+void* vec_tail( struct vec* vec );
+void vec_append( struct vec* vec, void* data );
+void vec_insert( struct vec* vec, u32 index, void* data );
+void* vec_replace( struct vec* vec, u32 index, void* data );
+void* vec_pop( struct vec* vec );
+void vec_deinit( struct vec* vec );
+
 // --------------------------------------------------------------------------
 
 #if OS_WINDOWS
@@ -130,10 +258,17 @@ struct fs_timestamp {
 
 #define strcasecmp _stricmp
 
+struct thread {
+   HANDLE handle;
+   void ( *start )( void* );
+   void* data;
+};
+
 #else
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
 struct fileid {
    dev_t device;
@@ -154,6 +289,12 @@ struct fs_timestamp {
    time_t value;
 };
 
+struct thread {
+   pthread_t handle;
+   void ( *start )( void* );
+   void* data;
+};
+
 #endif
 
 struct file_contents {
@@ -166,6 +307,14 @@ struct fs_result {
    int err;
 };
 
+// Contents of a file, either mapped into memory or read into a buffer.
+struct fs_mapped_file {
+   const u8* data;
+   size_t size;
+   int err;
+   bool mapped;
+};
+
 bool c_read_fileid( struct fileid*, const char* path );
 bool c_same_fileid( struct fileid*, struct fileid* );
 bool c_read_full_path( const char* path, struct str* );
@@ -179,9 +328,19 @@ bool fs_is_dir( struct fs_query* query );
 bool fs_get_mtime( struct fs_query* query, struct fs_timestamp* timestamp );
 bool fs_create_dir( const char* path, struct fs_result* result );
 const char* fs_get_tempdir( void );
+char* fs_get_cache_home( void );
+bool fs_create_private_dir( const char* path, struct fs_result* result );
+FILE* fs_create_temp_file( char* path );
 void fs_get_file_contents( const char* path, struct file_contents* contents );
+void fs_init_mapped_file( struct fs_mapped_file* file );
+bool fs_map_file( const char* path, struct fs_mapped_file* file );
+void fs_unmap_file( struct fs_mapped_file* file );
 void fs_strip_trailing_pathsep( struct str* path );
 bool fs_delete_file( const char* path );
 bool c_is_absolute_path( const char* path );
+bool thread_start( struct thread* thread, void ( *start )( void* ),
+   void* data );
+void thread_join( struct thread* thread );
+u32 thread_count_cpus( void );
 
 #endif
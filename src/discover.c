@@ -8,33 +8,61 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "task.h"
 #include "pcode.h"
 
+// Result of discovering the expression that starts at a pcode. The result
+// only depends on the pcode, so each expression is discovered once, no matter
+// how many times it is probed.
+struct expr_memo {
+   struct pcode* exit;
+   i32 stack_size;
+   enum {
+      MEMO_UNKNOWN,
+      MEMO_DISCOVERED,
+      MEMO_FAILED
+   } state;
+};
+
+// What a goto in the body of a loop or switch statement does.
+enum {
+   GOTO_BREAK = 0x1,
+   GOTO_CONTINUE = 0x2
+};
+
 struct discovery {
    struct task* task;
+   // Control-flow graph of the script or function being examined.
+   struct cfg cfg;
+   // Jumps into the script or function being examined.
+   struct jump_index* jumps;
+   // One entry for each pcode of the script or function being examined.
+   struct expr_memo* memos;
+   // One entry for each pcode. Tells whether a goto is a break or continue
+   // statement.
+   u8* gotos;
 };
 
 struct stmt_discovery {
    struct stmt_discovery* parent;
    struct pcode_range range;
-   i32 break_obj_pos;
-   i32 continue_obj_pos;
-   bool break_stmt;
-   bool continue_stmt;
+   // Where a break or continue statement in the innermost loop or switch
+   // statement around this statement jumps to.
+   struct pcode* break_target;
+   struct pcode* continue_target;
 };
 
 struct for_discovery {
    struct jump_pcode* cond_jump;
    struct jump_pcode* post_jump;
    struct jump_pcode* exit_jump;
-   struct list post;
+   struct vec post;
    bool discovered;
 };
 
 struct expr_discovery {
-   jmp_buf bail;
    struct pcode_range range;
    struct pcode* start;
    struct pcode* end;
@@ -45,6 +73,8 @@ struct expr_discovery {
    i32 optional_args;
    bool discovered;
    bool done;
+   // Set when the pcode do not make up an expression.
+   bool failed;
    bool more_args_given;
    bool optional_args_given;
    bool translation;
@@ -56,6 +86,9 @@ static void examine_script( struct discovery* discovery,
    struct script* script );
 static void examine_func_list( struct discovery* discovery );
 static void examine_func( struct discovery* discovery, struct func* func );
+static void init_body( struct discovery* discovery, struct pcode* start,
+   struct pcode* end, struct jump_index* jumps );
+static void finish_body( struct discovery* discovery );
 static void init_stmt_discovery( struct stmt_discovery* stmt,
    struct stmt_discovery* parent, struct pcode* start, struct pcode* end );
 static void init_range( struct pcode_range* range, struct pcode* start,
@@ -64,8 +97,23 @@ static bool have_pcode( struct pcode_range* range );
 static void seek_pcode( struct pcode_range* range, struct pcode* pcode );
 static void next_pcode( struct pcode_range* range );
 static bool in_range( struct pcode_range* range, struct pcode* pcode );
+static bool in_body( struct pcode* start, struct pcode* end,
+   struct pcode* pcode );
+static void set_break_target( struct discovery* discovery,
+   struct stmt_discovery* stmt, struct pcode* body_start,
+   struct pcode* body_end, struct pcode* target );
+static void set_continue_target( struct discovery* discovery,
+   struct stmt_discovery* stmt, struct pcode* body_start,
+   struct pcode* body_end, struct pcode* target );
+static void mark_gotos( struct discovery* discovery, struct pcode* body_start,
+   struct pcode* body_end, struct pcode* target, u8 kind, bool set );
+static u8* find_goto( struct discovery* discovery, struct pcode* pcode );
+static bool jumped_to_from( struct discovery* discovery, struct pcode* pcode,
+   struct pcode* start, struct pcode* end );
 static void examine_block( struct discovery* discovery,
    struct stmt_discovery* block );
+static bool closes_loop( struct discovery* discovery,
+   struct jump_pcode* jump );
 static void examine_stmt( struct discovery* discovery,
    struct stmt_discovery* stmt );
 static void examine_goto( struct discovery* discovery,
@@ -80,10 +128,12 @@ static void examine_expr( struct discovery* discovery,
 static void init_expr_discovery( struct expr_discovery* discovery,
    struct pcode* start, struct pcode* end );
 static void push( struct expr_discovery* discovery, i32 amount );
-static void pop( struct expr_discovery* discovery, i32 amount );
+static bool pop( struct expr_discovery* discovery, i32 amount );
 static void bail( struct expr_discovery* discovery );
 static void discover_expr( struct discovery* discovery,
    struct expr_discovery* expr_discovery );
+static struct expr_memo* find_memo( struct discovery* discovery,
+   struct pcode* pcode );
 static void examine_operand( struct discovery* discovery,
    struct expr_discovery* expr_discovery );
 static void examine_ded( struct discovery* discovery,
@@ -91,11 +141,14 @@ static void examine_ded( struct discovery* discovery,
 static void examine_ded_direct( struct discovery* discovery,
    struct expr_discovery* expr_discovery );
 static void examine_call_user( struct discovery* discovery,
-   struct expr_discovery* expr_discovery );
+   struct expr_discovery* expr_discovery,
+   const struct stack_effect* effect );
 static void examine_call_aspec( struct discovery* discovery,
-   struct expr_discovery* expr_discovery );
+   struct expr_discovery* expr_discovery,
+   const struct stack_effect* effect );
 static void examine_call_ext( struct discovery* discovery,
-   struct expr_discovery* expr_discovery );
+   struct expr_discovery* expr_discovery,
+   const struct stack_effect* effect );
 static void examine_expr_ifgoto( struct discovery* discovery,
    struct stmt_discovery* stmt, struct expr_discovery* expr );
 static void init_for_discovery( struct for_discovery* discovery );
@@ -131,22 +184,27 @@ static void examine_expr_stmt( struct stmt_discovery* stmt,
    struct expr_discovery* expr );
 
 void t_annotate( struct task* task ) {
+   struct mem_arena* arena = mem_select_arena( &task->annotate_region );
    struct discovery discovery;
    init_discovery( &discovery, task );
    examine_script_list( &discovery );
    examine_func_list( &discovery );
+   mem_select_arena( arena );
 }
 
 static void init_discovery( struct discovery* discovery, struct task* task ) {
    discovery->task = task;
+   discovery->jumps = NULL;
+   discovery->memos = NULL;
+   discovery->gotos = NULL;
 }
 
 static void examine_script_list( struct discovery* discovery ) {
-   struct list_iter i;
-   list_iterate( &discovery->task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      examine_script( discovery, list_data( &i ) );
-      list_next( &i );
+   for ( u32 i = 0; i < vec_size( &discovery->task->scripts ); ++i ) {
+      struct script* script = vec_at( &discovery->task->scripts, i );
+      if ( script->selected && ! script->cache.text ) {
+         examine_script( discovery, script );
+      }
    }
 }
 
@@ -156,16 +214,17 @@ static void examine_script( struct discovery* discovery,
    init_stmt_discovery( &body, NULL,
       script->body_start,
       script->body_end );
+   init_body( discovery, script->body_start, script->body_end,
+      &script->jumps );
    examine_block( discovery, &body );
+   finish_body( discovery );
 
 /*
    while ( have_pcode( &body.range ) ) {
       printf( "> %d", body.range.pcode->opcode );
       if ( body.range.generic ) {
-         struct generic_pcode_arg* arg = body.range.generic->args;
-         while ( arg ) {
-            printf( " %d", arg->value );
-            arg = arg->next;
+         for ( i32 i = 0; i < body.range.generic->num_args; ++i ) {
+            printf( " %d", body.range.generic->args[ i ] );
          }
       }
       next_pcode( &body.range );
@@ -176,11 +235,11 @@ t_bail( discovery->task );
 }
 
 static void examine_func_list( struct discovery* discovery ) {
-   struct list_iter i;
-   list_iterate( &discovery->task->funcs, &i );
-   while ( ! list_end( &i ) ) {
-      examine_func( discovery, list_data( &i ) );
-      list_next( &i );
+   for ( u32 i = 0; i < vec_size( &discovery->task->funcs ); ++i ) {
+      struct func* func = vec_at( &discovery->task->funcs, i );
+      if ( func->more.user->selected && ! func->more.user->cache.text ) {
+         examine_func( discovery, func );
+      }
    }
 }
 
@@ -189,17 +248,41 @@ static void examine_func( struct discovery* discovery, struct func* func ) {
    init_stmt_discovery( &body, NULL,
       func->more.user->start,
       func->more.user->end );
+   init_body( discovery, func->more.user->start, func->more.user->end,
+      &func->more.user->jumps );
    examine_block( discovery, &body );
+   finish_body( discovery );
+}
+
+static void init_body( struct discovery* discovery, struct pcode* start,
+   struct pcode* end, struct jump_index* jumps ) {
+   struct mem_arena* arena = mem_select_arena(
+      &discovery->task->body_region );
+   t_build_cfg( &discovery->cfg, start, end );
+   size_t size = sizeof( discovery->memos[ 0 ] ) * discovery->cfg.num_slots;
+   discovery->memos = mem_alloc( size );
+   memset( discovery->memos, 0, size );
+   size = sizeof( discovery->gotos[ 0 ] ) * discovery->cfg.num_slots;
+   discovery->gotos = mem_alloc( size );
+   memset( discovery->gotos, 0, size );
+   mem_select_arena( arena );
+   discovery->jumps = jumps;
+}
+
+// The control-flow graph, the memos, and the gotos are only needed while the
+// body is examined.
+static void finish_body( struct discovery* discovery ) {
+   mem_arena_deinit( &discovery->task->body_region );
+   discovery->memos = NULL;
+   discovery->gotos = NULL;
 }
 
 static void init_stmt_discovery( struct stmt_discovery* stmt,
    struct stmt_discovery* parent, struct pcode* start, struct pcode* end ) {
    stmt->parent = parent;
    init_range( &stmt->range, start, end );
-   stmt->break_obj_pos = 0;
-   stmt->continue_obj_pos = 0;
-   stmt->break_stmt = false;
-   stmt->continue_stmt = false;
+   stmt->break_target = parent ? parent->break_target : NULL;
+   stmt->continue_target = parent ? parent->continue_target : NULL;
 }
 
 static void init_range( struct pcode_range* range, struct pcode* start,
@@ -209,8 +292,11 @@ static void init_range( struct pcode_range* range, struct pcode* start,
    seek_pcode( range, range->start );
 }
 
+// The pcode of a body is stored in one array, so the position of a pcode in
+// the body is compared by its address.
 static bool have_pcode( struct pcode_range* range ) {
-   return ( range->pcode->obj_pos <= range->end->obj_pos );
+   return ( ( union pcode_slot* ) range->pcode <=
+      ( union pcode_slot* ) range->end );
 }
 
 static void seek_pcode( struct pcode_range* range, struct pcode* pcode ) {
@@ -237,12 +323,81 @@ static void seek_pcode( struct pcode_range* range, struct pcode* pcode ) {
 }
 
 static void next_pcode( struct pcode_range* range ) {
-   seek_pcode( range, range->pcode->next );
+   seek_pcode( range, PCODE_NEXT( range->pcode ) );
 }
 
 static bool in_range( struct pcode_range* range, struct pcode* pcode ) {
-   return ( pcode->obj_pos >= range->start->obj_pos &&
-      pcode->obj_pos <= range->end->obj_pos );
+   return in_body( range->start, range->end, pcode );
+}
+
+static bool in_body( struct pcode* start, struct pcode* end,
+   struct pcode* pcode ) {
+   union pcode_slot* slot = ( union pcode_slot* ) pcode;
+   return ( slot >= ( union pcode_slot* ) start &&
+      slot <= ( union pcode_slot* ) end );
+}
+
+// The gotos in the body that jump to the exit of the loop or switch statement
+// are break statements. A break statement only leaves the innermost statement,
+// so the gotos in the body that jump to the exit of an enclosing statement are
+// no longer break statements.
+static void set_break_target( struct discovery* discovery,
+   struct stmt_discovery* stmt, struct pcode* body_start,
+   struct pcode* body_end, struct pcode* target ) {
+   mark_gotos( discovery, body_start, body_end, stmt->break_target,
+      GOTO_BREAK, false );
+   mark_gotos( discovery, body_start, body_end, target, GOTO_BREAK, true );
+   stmt->break_target = target;
+}
+
+static void set_continue_target( struct discovery* discovery,
+   struct stmt_discovery* stmt, struct pcode* body_start,
+   struct pcode* body_end, struct pcode* target ) {
+   mark_gotos( discovery, body_start, body_end, stmt->continue_target,
+      GOTO_CONTINUE, false );
+   mark_gotos( discovery, body_start, body_end, target, GOTO_CONTINUE, true );
+   stmt->continue_target = target;
+}
+
+static void mark_gotos( struct discovery* discovery, struct pcode* body_start,
+   struct pcode* body_end, struct pcode* target, u8 kind, bool set ) {
+   if ( ! target ) {
+      return;
+   }
+   u32 count = 0;
+   struct pcode** sources = t_find_jumps_to( discovery->jumps, target,
+      &count );
+   for ( u32 i = 0; i < count; ++i ) {
+      if ( sources[ i ]->opcode == PCD_GOTO &&
+         in_body( body_start, body_end, sources[ i ] ) ) {
+         u8* gotos = find_goto( discovery, sources[ i ] );
+         if ( set ) {
+            *gotos = ( u8 ) ( *gotos | kind );
+         }
+         else {
+            *gotos = ( u8 ) ( *gotos & ~kind );
+         }
+      }
+   }
+}
+
+static u8* find_goto( struct discovery* discovery, struct pcode* pcode ) {
+   return &discovery->gotos[ ( union pcode_slot* ) pcode -
+      ( union pcode_slot* ) discovery->cfg.start ];
+}
+
+// Tells whether a jump between the start and the end pcode goes to the pcode.
+static bool jumped_to_from( struct discovery* discovery, struct pcode* pcode,
+   struct pcode* start, struct pcode* end ) {
+   u32 count = 0;
+   struct pcode** sources = t_find_jumps_to( discovery->jumps, pcode,
+      &count );
+   for ( u32 i = 0; i < count; ++i ) {
+      if ( in_body( start, end, sources[ i ] ) ) {
+         return true;
+      }
+   }
+   return false;
 }
 
 static void examine_block( struct discovery* discovery,
@@ -256,6 +411,14 @@ static void examine_block( struct discovery* discovery,
    }
 }
 
+// A jump that goes back to the start of a loop, as opposed to any other
+// backward jump, like one made by a goto statement.
+static bool closes_loop( struct discovery* discovery,
+   struct jump_pcode* jump ) {
+   return t_cfg_closes_loop( &discovery->cfg, &jump->pcode,
+      jump->destination );
+}
+
 static void examine_stmt( struct discovery* discovery,
    struct stmt_discovery* stmt ) {
    switch ( stmt->range.pcode->opcode ) {
@@ -267,25 +430,16 @@ static void examine_stmt( struct discovery* discovery,
    }
 }
 
+// The gotos that are break and continue statements were marked when the loop
+// or switch statement around them was found.
 static void examine_goto( struct discovery* discovery,
    struct stmt_discovery* stmt_discovery ) {
-   // Check for break statement.
-   struct stmt_discovery* target = stmt_discovery->parent;
-   while ( target && ! target->break_stmt ) {
-      target = target->parent;
-   }
-   if ( target && stmt_discovery->range.jump->destination->obj_pos ==
-      target->break_obj_pos ) {
+   u8 gotos = *find_goto( discovery, stmt_discovery->range.pcode );
+   if ( gotos & GOTO_BREAK ) {
       examine_break( stmt_discovery );
       return;
    }
-   // Check for continue statement.
-   target = stmt_discovery->parent;
-   while ( target && ! target->continue_stmt ) {
-      target = target->parent;
-   }
-   if ( target && stmt_discovery->range.jump->destination->obj_pos ==
-      target->continue_obj_pos ) {
+   if ( gotos & GOTO_CONTINUE ) {
       examine_continue( stmt_discovery );
       return;
    }
@@ -299,7 +453,7 @@ static void examine_goto( struct discovery* discovery,
 }
 
 static void examine_break( struct stmt_discovery* stmt ) {
-   struct jump_note* note = mem_alloc( sizeof( *note ) );
+   struct jump_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_JUMP );
    note->stmt = JUMPNOTE_BREAK;
    append_note( stmt->range.pcode, &note->note );
@@ -307,7 +461,7 @@ static void examine_break( struct stmt_discovery* stmt ) {
 }
 
 static void examine_continue( struct stmt_discovery* stmt ) {
-   struct jump_note* note = mem_alloc( sizeof( *note ) );
+   struct jump_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_JUMP );
    note->stmt = JUMPNOTE_CONTINUE;
    append_note( stmt->range.pcode, &note->note );
@@ -316,18 +470,27 @@ static void examine_continue( struct stmt_discovery* stmt ) {
 
 static void examine_goto_down( struct discovery* discovery,
    struct stmt_discovery* stmt ) {
+   // The condition of a loop jumps back to the pcode after the goto. When
+   // nothing jumps there, the goto does not start a loop, so there is no need
+   // to look for a condition.
+   if ( ! t_is_jump_target( discovery->jumps,
+      PCODE_NEXT( stmt->range.pcode ) ) ) {
+      next_pcode( &stmt->range );
+      return;
+   }
    struct expr_discovery expr;
    init_expr_discovery( &expr, stmt->range.jump->destination,
       stmt->range.end );
    discover_expr( discovery, &expr );
-   if ( expr.discovered && ( expr.exit->next->opcode == PCD_IFGOTO ||
-      expr.exit->next->opcode == PCD_IFNOTGOTO ) ) {
-      struct jump_pcode* body_jump = ( struct jump_pcode* ) expr.exit->next;
-      if ( body_jump->destination == stmt->range.jump->pcode.next ) {
+   if ( expr.discovered && ( PCODE_NEXT( expr.exit )->opcode == PCD_IFGOTO ||
+      PCODE_NEXT( expr.exit )->opcode == PCD_IFNOTGOTO ) ) {
+      struct jump_pcode* body_jump =
+         ( struct jump_pcode* ) PCODE_NEXT( expr.exit );
+      if ( body_jump->destination == PCODE_NEXT( &stmt->range.jump->pcode ) ) {
          struct loop_note* note = alloc_loop_note();
          note->cond_start = expr.start;
-         note->body_start = stmt->range.pcode->next;
-         note->exit = body_jump->pcode.next;
+         note->body_start = PCODE_NEXT( stmt->range.pcode );
+         note->exit = PCODE_NEXT( &body_jump->pcode );
          if ( stmt->range.pcode->opcode == PCD_IFNOTGOTO ) {
             note->until = true;
          }
@@ -344,7 +507,7 @@ static void examine_goto_down( struct discovery* discovery,
 }
 
 static struct loop_note* alloc_loop_note( void ) {
-   struct loop_note* note = mem_alloc( sizeof( *note ) );
+   struct loop_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_LOOP );
    note->cond_start = NULL;
    note->cond_end = NULL;
@@ -404,6 +567,7 @@ static void init_expr_discovery( struct expr_discovery* discovery,
    discovery->more_args_given = false;
    discovery->optional_args_given = false;
    discovery->done = false;
+   discovery->failed = false;
    discovery->translation = false;
 }
 
@@ -411,71 +575,96 @@ static void push( struct expr_discovery* discovery, i32 amount ) {
    discovery->stack_size += amount;
 }
 
-static void pop( struct expr_discovery* discovery, i32 amount ) {
+static bool pop( struct expr_discovery* discovery, i32 amount ) {
    if ( discovery->stack_size >= amount ) {
       discovery->stack_size -= amount;
+      return true;
    }
    else {
       bail( discovery );
+      return false;
    }
 }
 
 static void bail( struct expr_discovery* discovery ) {
-   longjmp( discovery->bail, 1 );
+   discovery->failed = true;
 }
 
 static void discover_expr( struct discovery* discovery,
    struct expr_discovery* expr_discovery ) {
-   if ( setjmp( expr_discovery->bail ) == 0 ) {
-      while ( ! expr_discovery->done ) {
-         examine_operand( discovery, expr_discovery );
+   struct expr_memo* memo = find_memo( discovery, expr_discovery->start );
+   if ( memo && memo->state != MEMO_UNKNOWN ) {
+      if ( memo->state == MEMO_DISCOVERED ) {
+         expr_discovery->exit = memo->exit;
+         expr_discovery->end = PCODE_PREV( memo->exit );
+         expr_discovery->stack_size = memo->stack_size;
+         expr_discovery->discovered = true;
       }
+      return;
+   }
+   while ( ! expr_discovery->done && ! expr_discovery->failed ) {
+      examine_operand( discovery, expr_discovery );
+   }
+   if ( ! expr_discovery->failed ) {
       expr_discovery->exit = expr_discovery->range.pcode;
-      expr_discovery->end = expr_discovery->exit->prev;
+      expr_discovery->end = PCODE_PREV( expr_discovery->exit );
       expr_discovery->discovered = true;
    }
+   if ( memo ) {
+      memo->exit = expr_discovery->exit;
+      memo->stack_size = expr_discovery->stack_size;
+      memo->state = expr_discovery->discovered ? MEMO_DISCOVERED :
+         MEMO_FAILED;
+   }
+}
+
+static struct expr_memo* find_memo( struct discovery* discovery,
+   struct pcode* pcode ) {
+   union pcode_slot* slot = ( union pcode_slot* ) pcode;
+   union pcode_slot* first = ( union pcode_slot* ) discovery->cfg.start;
+   if ( slot >= first && slot < first + discovery->cfg.num_slots ) {
+      return &discovery->memos[ slot - first ];
+   }
+   return NULL;
 }
 
 static void examine_operand( struct discovery* discovery,
    struct expr_discovery* expr_discovery ) {
-   switch ( expr_discovery->range.pcode->opcode ) {
-   case PCD_PUSHNUMBER:
-   case PCD_PUSHBYTE:
-      push( expr_discovery, 1 );
+   const struct stack_effect* effect = c_get_stack_effect(
+      ( enum pcd ) expr_discovery->range.pcode->opcode );
+   switch ( effect->kind ) {
+   case OPERAND_LITERAL:
+   case OPERAND_PUSHARRAY:
+   case OPERAND_ASSIGNARRAY:
+   case OPERAND_BINARY:
+   case OPERAND_UNARY:
+   case OPERAND_MINUS:
+   case OPERAND_TAGSTRING:
+   case OPERAND_ASPECFIXED:
+   case OPERAND_STRCPY:
+      pop( expr_discovery, effect->pops );
+      push( expr_discovery, ( effect->pushes == STACK_VARIADIC ) ?
+         expr_discovery->range.generic->args[ 0 ] : effect->pushes );
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_PUSH2BYTES:
-   case PCD_PUSH3BYTES:
-   case PCD_PUSH4BYTES:
-   case PCD_PUSH5BYTES:
-      push( expr_discovery, expr_discovery->range.pcode->opcode -
-         PCD_PUSH2BYTES + 2 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_PUSHBYTES:
-      push( expr_discovery, expr_discovery->range.generic->args->value );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_DUP:
+   case OPERAND_DUP:
       if ( ! ( expr_discovery->stack_size > 0 ) ) {
          bail( expr_discovery );
+         return;
       }
-      push( expr_discovery, 1 );
+      push( expr_discovery, effect->pushes );
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_DROP:
+   case OPERAND_DROP:
       if ( expr_discovery->stack_size > 1 &&
          expr_discovery->print_depth == 0 &&
          ! expr_discovery->translation ) {
-         pop( expr_discovery, 1 );
+         pop( expr_discovery, effect->pops );
       }
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_PUSHSCRIPTVAR:
-   case PCD_PUSHMAPVAR:
-   case PCD_PUSHWORLDVAR:
-   case PCD_PUSHGLOBALVAR:
-      push( expr_discovery, 1 );
+   case OPERAND_PUSHVAR:
+      push( expr_discovery, effect->pushes );
       next_pcode( &expr_discovery->range );
       switch ( expr_discovery->range.pcode->opcode ) {
       case PCD_INCSCRIPTVAR:
@@ -487,30 +676,7 @@ static void examine_operand( struct discovery* discovery,
          break;
       }
       break;
-   case PCD_PUSHSCRIPTARRAY:
-   case PCD_PUSHMAPARRAY:
-   case PCD_PUSHWORLDARRAY:
-   case PCD_PUSHGLOBALARRAY:
-      pop( expr_discovery, 1 );
-      push( expr_discovery, 1 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_UNARYMINUS:
-   case PCD_NEGATELOGICAL:
-   case PCD_NEGATEBINARY:
-   case PCD_TAGSTRING:
-      pop( expr_discovery, 1 );
-      push( expr_discovery, 1 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_INCSCRIPTVAR:
-   case PCD_INCMAPVAR:
-   case PCD_INCWORLDVAR:
-   case PCD_INCGLOBALVAR:
-   case PCD_DECSCRIPTVAR:
-   case PCD_DECMAPVAR:
-   case PCD_DECWORLDVAR:
-   case PCD_DECGLOBALVAR:
+   case OPERAND_INC:
       next_pcode( &expr_discovery->range );
       switch ( expr_discovery->range.pcode->opcode ) {
       case PCD_PUSHSCRIPTVAR:
@@ -523,15 +689,8 @@ static void examine_operand( struct discovery* discovery,
          break;
       }
       break;
-   case PCD_INCSCRIPTARRAY:
-   case PCD_INCMAPARRAY:
-   case PCD_INCWORLDARRAY:
-   case PCD_INCGLOBALARRAY:
-   case PCD_DECSCRIPTARRAY:
-   case PCD_DECMAPARRAY:
-   case PCD_DECWORLDARRAY:
-   case PCD_DECGLOBALARRAY:
-      pop( expr_discovery, 1 );
+   case OPERAND_ARRAYINC:
+      pop( expr_discovery, effect->pops );
       next_pcode( &expr_discovery->range );
       switch ( expr_discovery->range.pcode->opcode ) {
       case PCD_PUSHSCRIPTARRAY:
@@ -545,362 +704,101 @@ static void examine_operand( struct discovery* discovery,
          break;
       }
       break;
-   case PCD_ASSIGNSCRIPTVAR:
-   case PCD_ADDSCRIPTVAR:
-   case PCD_SUBSCRIPTVAR:
-   case PCD_MULSCRIPTVAR:
-   case PCD_DIVSCRIPTVAR:
-   case PCD_MODSCRIPTVAR:
-   case PCD_ANDSCRIPTVAR:
-   case PCD_EORSCRIPTVAR:
-   case PCD_ORSCRIPTVAR:
-   case PCD_LSSCRIPTVAR:
-   case PCD_RSSCRIPTVAR:
-   case PCD_ASSIGNMAPVAR:
-   case PCD_ADDMAPVAR:
-   case PCD_SUBMAPVAR:
-   case PCD_MULMAPVAR:
-   case PCD_DIVMAPVAR:
-   case PCD_MODMAPVAR:
-   case PCD_ANDMAPVAR:
-   case PCD_EORMAPVAR:
-   case PCD_ORMAPVAR:
-   case PCD_LSMAPVAR:
-   case PCD_RSMAPVAR:
-   case PCD_ASSIGNWORLDVAR:
-   case PCD_ADDWORLDVAR:
-   case PCD_SUBWORLDVAR:
-   case PCD_MULWORLDVAR:
-   case PCD_DIVWORLDVAR:
-   case PCD_MODWORLDVAR:
-   case PCD_ANDWORLDVAR:
-   case PCD_EORWORLDVAR:
-   case PCD_ORWORLDVAR:
-   case PCD_LSWORLDVAR:
-   case PCD_RSWORLDVAR:
-   case PCD_ASSIGNGLOBALVAR:
-   case PCD_ADDGLOBALVAR:
-   case PCD_SUBGLOBALVAR:
-   case PCD_MULGLOBALVAR:
-   case PCD_DIVGLOBALVAR:
-   case PCD_MODGLOBALVAR:
-   case PCD_ANDGLOBALVAR:
-   case PCD_EORGLOBALVAR:
-   case PCD_ORGLOBALVAR:
-   case PCD_LSGLOBALVAR:
-   case PCD_RSGLOBALVAR:
-      pop( expr_discovery, 1 );
+   case OPERAND_ASSIGN:
+      pop( expr_discovery, effect->pops );
       next_pcode( &expr_discovery->range );
       if ( expr_discovery->stack_size == 0 ) {
          expr_discovery->done = true;
       }
       break;
-   case PCD_ASSIGNSCRIPTARRAY:
-   case PCD_ADDSCRIPTARRAY:
-   case PCD_SUBSCRIPTARRAY:
-   case PCD_MULSCRIPTARRAY:
-   case PCD_DIVSCRIPTARRAY:
-   case PCD_MODSCRIPTARRAY:
-   case PCD_ANDSCRIPTARRAY:
-   case PCD_EORSCRIPTARRAY:
-   case PCD_ORSCRIPTARRAY:
-   case PCD_LSSCRIPTARRAY:
-   case PCD_RSSCRIPTARRAY:
-   case PCD_ASSIGNMAPARRAY:
-   case PCD_ADDMAPARRAY:
-   case PCD_SUBMAPARRAY:
-   case PCD_MULMAPARRAY:
-   case PCD_DIVMAPARRAY:
-   case PCD_MODMAPARRAY:
-   case PCD_ANDMAPARRAY:
-   case PCD_EORMAPARRAY:
-   case PCD_ORMAPARRAY:
-   case PCD_LSMAPARRAY:
-   case PCD_RSMAPARRAY:
-   case PCD_ASSIGNWORLDARRAY:
-   case PCD_ADDWORLDARRAY:
-   case PCD_SUBWORLDARRAY:
-   case PCD_MULWORLDARRAY:
-   case PCD_DIVWORLDARRAY:
-   case PCD_MODWORLDARRAY:
-   case PCD_ANDWORLDARRAY:
-   case PCD_EORWORLDARRAY:
-   case PCD_ORWORLDARRAY:
-   case PCD_LSWORLDARRAY:
-   case PCD_RSWORLDARRAY:
-   case PCD_ASSIGNGLOBALARRAY:
-   case PCD_ADDGLOBALARRAY:
-   case PCD_SUBGLOBALARRAY:
-   case PCD_MULGLOBALARRAY:
-   case PCD_DIVGLOBALARRAY:
-   case PCD_MODGLOBALARRAY:
-   case PCD_ANDGLOBALARRAY:
-   case PCD_EORGLOBALARRAY:
-   case PCD_ORGLOBALARRAY:
-   case PCD_LSGLOBALARRAY:
-   case PCD_RSGLOBALARRAY:
-      pop( expr_discovery, 2 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_DELAY:
-   case PCD_RANDOM:
-   case PCD_THINGCOUNT:
-   case PCD_TAGWAIT:
-   case PCD_POLYWAIT:
-   case PCD_CHANGEFLOOR:
-   case PCD_CHANGECEILING:
-   case PCD_LINESIDE:
-   case PCD_SCRIPTWAIT:
-   case PCD_CLEARLINESPECIAL:
-   case PCD_PLAYERCOUNT:
-   case PCD_GAMETYPE:
-   case PCD_GAMESKILL:
-   case PCD_TIMER:
-   case PCD_SECTORSOUND:
-   case PCD_AMBIENTSOUND:
-   case PCD_SOUNDSEQUENCE:
-   case PCD_SETLINETEXTURE:
-   case PCD_SETLINEBLOCKING:
-   case PCD_SETLINESPECIAL:
-   case PCD_THINGSOUND:
-   case PCD_ACTIVATORSOUND:
-   case PCD_LOCALAMBIENTSOUND:
-   case PCD_SETLINEMONSTERBLOCKING:
-   case PCD_ISNETWORKGAME:
-   case PCD_PLAYERTEAM:
-   case PCD_PLAYERHEALTH:
-   case PCD_PLAYERARMORPOINTS:
-   case PCD_PLAYERFRAGS:
-   case PCD_BLUETEAMCOUNT:
-   case PCD_REDTEAMCOUNT:
-   case PCD_BLUETEAMSCORE:
-   case PCD_REDTEAMSCORE:
-   case PCD_ISONEFLAGCTF:
-   case PCD_GETINVASIONWAVE:
-   case PCD_GETINVASIONSTATE:
-   case PCD_MUSICCHANGE:
-   case PCD_CONSOLECOMMAND:
-   case PCD_SINGLEPLAYER:
-   case PCD_FIXEDMUL:
-   case PCD_FIXEDDIV:
-   case PCD_SETGRAVITY:
-   case PCD_SETAIRCONTROL:
-   case PCD_CLEARINVENTORY:
-   case PCD_GIVEINVENTORY:
-   case PCD_TAKEINVENTORY:
-   case PCD_CHECKINVENTORY:
-   case PCD_SPAWN:
-   case PCD_SPAWNSPOT:
-   case PCD_SETMUSIC:
-   case PCD_LOCALSETMUSIC:
-   case PCD_SETFONT:
-   case PCD_SETTHINGSPECIAL:
-   case PCD_FADETO:
-   case PCD_FADERANGE:
-   case PCD_CANCELFADE:
-   case PCD_PLAYMOVIE:
-   case PCD_SETFLOORTRIGGER:
-   case PCD_SETCEILINGTRIGGER:
-   case PCD_GETACTORX:
-   case PCD_GETACTORY:
-   case PCD_GETACTORZ:
-   case PCD_SIN:
-   case PCD_COS:
-   case PCD_VECTORANGLE:
-   case PCD_CHECKWEAPON:
-   case PCD_SETWEAPON:
-   case PCD_SETMARINEWEAPON:
-   case PCD_SETACTORPROPERTY:
-   case PCD_GETACTORPROPERTY:
-   case PCD_PLAYERNUMBER:
-   case PCD_ACTIVATORTID:
-   case PCD_SETMARINESPRITE:
-   case PCD_GETSCREENWIDTH:
-   case PCD_GETSCREENHEIGHT:
-   case PCD_THINGPROJECTILE2:
-   case PCD_STRLEN:
-   case PCD_SETHUDSIZE:
-   case PCD_GETCVAR:
-   case PCD_SETRESULTVALUE:
-   case PCD_GETLINEROWOFFSET:
-   case PCD_GETACTORFLOORZ:
-   case PCD_GETACTORANGLE:
-   case PCD_GETSECTORFLOORZ:
-   case PCD_GETSECTORCEILINGZ:
-   case PCD_GETSIGILPIECES:
-   case PCD_GETLEVELINFO:
-   case PCD_CHANGESKY:
-   case PCD_PLAYERINGAME:
-   case PCD_PLAYERISBOT:
-   case PCD_SETCAMERATOTEXTURE:
-   case PCD_GETAMMOCAPACITY:
-   case PCD_SETAMMOCAPACITY:
-   case PCD_SETACTORANGLE:
-   case PCD_SPAWNPROJECTILE:
-   case PCD_GETSECTORLIGHTLEVEL:
-   case PCD_GETACTORCEILINGZ:
-   case PCD_SETACTORPOSITION:
-   case PCD_CLEARACTORINVENTORY:
-   case PCD_GIVEACTORINVENTORY:
-   case PCD_TAKEACTORINVENTORY:
-   case PCD_CHECKACTORINVENTORY:
-   case PCD_THINGCOUNTNAME:
-   case PCD_SPAWNSPOTFACING:
-   case PCD_PLAYERCLASS:
-   case PCD_GETPLAYERINFO:
-   case PCD_CHANGELEVEL:
-   case PCD_SECTORDAMAGE:
-   case PCD_REPLACETEXTURES:
-   case PCD_GETACTORPITCH:
-   case PCD_SETACTORPITCH:
-   case PCD_SETACTORSTATE:
-   case PCD_THINGDAMAGE2:
-   case PCD_USEINVENTORY:
-   case PCD_USEACTORINVENTORY:
-   case PCD_CHECKACTORCEILINGTEXTURE:
-   case PCD_CHECKACTORFLOORTEXTURE:
-   case PCD_GETACTORLIGHTLEVEL:
-   case PCD_SETMUGSHOTSTATE:
-   case PCD_THINGCOUNTSECTOR:
-   case PCD_THINGCOUNTNAMESECTOR:
-   case PCD_CHECKPLAYERCAMERA:
-   case PCD_MORPHACTOR:
-   case PCD_UNMORPHACTOR:
-   case PCD_GETPLAYERINPUT:
-   case PCD_CLASSIFYACTOR:
-   case PCD_SCRIPTWAITNAMED:
+   case OPERAND_DED:
       examine_ded( discovery, expr_discovery );
       if ( expr_discovery->stack_size == 0 ) {
          expr_discovery->done = true;
       }
       break;
-   case PCD_DELAYDIRECT:
-   case PCD_RANDOMDIRECT:
-   case PCD_THINGCOUNTDIRECT:
-   case PCD_TAGWAITDIRECT:
-   case PCD_POLYWAITDIRECT:
-   case PCD_CHANGEFLOORDIRECT:
-   case PCD_CHANGECEILINGDIRECT:
-   case PCD_SCRIPTWAITDIRECT:
-   case PCD_CONSOLECOMMANDDIRECT:
-   case PCD_SETGRAVITYDIRECT:
-   case PCD_SETAIRCONTROLDIRECT:
-   case PCD_GIVEINVENTORYDIRECT:
-   case PCD_TAKEINVENTORYDIRECT:
-   case PCD_CHECKINVENTORYDIRECT:
-   case PCD_SPAWNDIRECT:
-   case PCD_SPAWNSPOTDIRECT:
-   case PCD_SETMUSICDIRECT:
-   case PCD_LOCALSETMUSICDIRECT:
-   case PCD_SETSTYLEDIRECT:
-   case PCD_SETFONTDIRECT:
-   case PCD_DELAYDIRECTB:
-   case PCD_RANDOMDIRECTB:
+   case OPERAND_DEDDIRECT:
       examine_ded_direct( discovery, expr_discovery );
       if ( expr_discovery->stack_size == 0 ) {
          expr_discovery->done = true;
       }
       break;
-   case PCD_ORLOGICAL:
-   case PCD_ANDLOGICAL:
-   case PCD_ORBITWISE:
-   case PCD_EORBITWISE:
-   case PCD_ANDBITWISE:
-   case PCD_EQ:
-   case PCD_NE:
-   case PCD_LT:
-   case PCD_LE:
-   case PCD_GT:
-   case PCD_GE:
-   case PCD_LSHIFT:
-   case PCD_RSHIFT:
-   case PCD_ADD:
-   case PCD_SUBTRACT:
-   case PCD_MULTIPLY:
-   case PCD_DIVIDE:
-   case PCD_MODULUS:
-      pop( expr_discovery, 2 );
-      push( expr_discovery, 1 );
-      next_pcode( &expr_discovery->range );
+   case OPERAND_ASPEC:
+      examine_call_aspec( discovery, expr_discovery, effect );
       break;
-   case PCD_BEGINPRINT:
-      ++expr_discovery->print_depth;
+   case OPERAND_ASPECDIRECT:
       next_pcode( &expr_discovery->range );
-      break;
-   case PCD_PRINTSTRING:
-   case PCD_PRINTNUMBER:
-   case PCD_PRINTCHARACTER:
-   case PCD_PRINTNAME:
-   case PCD_PRINTFIXED:
-   case PCD_PRINTLOCALIZED:
-   case PCD_PRINTBIND:
-   case PCD_PRINTBINARY:
-   case PCD_PRINTHEX:
-      if ( ! ( expr_discovery->print_depth > 0 ) ) {
-         bail( expr_discovery );
+      if ( expr_discovery->stack_size == 0 ) {
+         expr_discovery->done = true;
       }
-      pop( expr_discovery, 1 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_PRINTMAPCHARARRAY:
-   case PCD_PRINTWORLDCHARARRAY:
-   case PCD_PRINTGLOBALCHARARRAY:
-      if ( ! ( expr_discovery->print_depth > 0 ) ) {
+      else {
          bail( expr_discovery );
+         return;
       }
-      pop( expr_discovery, 2 );
+      break;
+   case OPERAND_CALLUSER:
+      examine_call_user( discovery, expr_discovery, effect );
+      break;
+   case OPERAND_CALLEXT:
+      examine_call_ext( discovery, expr_discovery, effect );
+      break;
+   case OPERAND_BEGINPRINT:
+      ++expr_discovery->print_depth;
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_PRINTMAPCHRANGE:
-   case PCD_PRINTWORLDCHRANGE:
-   case PCD_PRINTGLOBALCHRANGE:
+   case OPERAND_PRINTVALUE:
+   case OPERAND_PRINTARRAY:
       if ( ! ( expr_discovery->print_depth > 0 ) ) {
          bail( expr_discovery );
+         return;
       }
-      pop( expr_discovery, 4 );
+      pop( expr_discovery, effect->pops );
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_ENDPRINT:
-   case PCD_ENDPRINTBOLD:
-   case PCD_ENDLOG:
+   case OPERAND_ENDPRINT:
       if ( ! ( expr_discovery->print_depth > 0 ) ) {
          bail( expr_discovery );
+         return;
       }
       --expr_discovery->print_depth;
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_SAVESTRING:
+   case OPERAND_SAVESTRING:
       if ( ! ( expr_discovery->print_depth > 0 ) ) {
          bail( expr_discovery );
+         return;
       }
       --expr_discovery->print_depth;
-      push( expr_discovery, 1 );
+      push( expr_discovery, effect->pushes );
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_MOREHUDMESSAGE:
+   case OPERAND_MOREHUDMESSAGE:
       if ( ! ( expr_discovery->print_depth > 0 ) ) {
          bail( expr_discovery );
+         return;
       }
       expr_discovery->more_args = expr_discovery->stack_size;
       expr_discovery->more_args_given = true;
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_OPTHUDMESSAGE:
+   case OPERAND_OPTHUDMESSAGE:
       if ( ! ( expr_discovery->print_depth > 0 &&
          expr_discovery->more_args_given ) ) {
          bail( expr_discovery );
+         return;
       }
       expr_discovery->optional_args = expr_discovery->stack_size;
       expr_discovery->optional_args_given = true;
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_ENDHUDMESSAGE:
-   case PCD_ENDHUDMESSAGEBOLD:
+   case OPERAND_ENDHUDMESSAGE:
       if ( ! ( expr_discovery->print_depth > 0 ) ) {
          bail( expr_discovery );
+         return;
       }
       if ( ! expr_discovery->more_args_given ) {
          bail( expr_discovery );
+         return;
       }
       if ( expr_discovery->optional_args_given ) {
          pop( expr_discovery, expr_discovery->stack_size -
@@ -911,95 +809,27 @@ static void examine_operand( struct discovery* discovery,
       next_pcode( &expr_discovery->range );
       --expr_discovery->print_depth;
       break;
-   case PCD_STRCPYTOMAPCHRANGE:
-   case PCD_STRCPYTOWORLDCHRANGE:
-   case PCD_STRCPYTOGLOBALCHRANGE:
-      pop( expr_discovery, 6 );
-      push( expr_discovery, 1 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_LSPEC1:
-   case PCD_LSPEC2:
-   case PCD_LSPEC3:
-   case PCD_LSPEC4:
-   case PCD_LSPEC5:
-      examine_call_aspec( discovery, expr_discovery );
-      break;
-   case PCD_LSPEC5EX:
-      pop( expr_discovery, 5 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_LSPEC1DIRECT:
-   case PCD_LSPEC2DIRECT:
-   case PCD_LSPEC3DIRECT:
-   case PCD_LSPEC4DIRECT:
-   case PCD_LSPEC5DIRECT:
-   case PCD_LSPEC1DIRECTB:
-   case PCD_LSPEC2DIRECTB:
-   case PCD_LSPEC3DIRECTB:
-   case PCD_LSPEC4DIRECTB:
-   case PCD_LSPEC5DIRECTB:
-      next_pcode( &expr_discovery->range );
-      if ( expr_discovery->stack_size == 0 ) {
-         expr_discovery->done = true;
-      }
-      else {
-         bail( expr_discovery );
-      }
-      break;
-   case PCD_LSPEC5RESULT:
-   case PCD_LSPEC5EXRESULT:
-      pop( expr_discovery, 5 );
-      push( expr_discovery, 1 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_CALL:
-   case PCD_CALLDISCARD:
-      examine_call_user( discovery, expr_discovery );
-      break;
-   case PCD_CALLFUNC:
-      examine_call_ext( discovery, expr_discovery );
-      break;
-   case PCD_STARTTRANSLATION:
+   case OPERAND_STARTTRANSLATION:
       if ( expr_discovery->translation ) {
          bail( expr_discovery );
+         return;
       }
-      pop( expr_discovery, 1 );
+      pop( expr_discovery, effect->pops );
       next_pcode( &expr_discovery->range );
       expr_discovery->translation = true;
       break;
-   case PCD_TRANSLATIONRANGE1:
-      if ( ! expr_discovery->translation ) {
-         bail( expr_discovery );
-      }
-      pop( expr_discovery, 4 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_TRANSLATIONRANGE2:
-   case PCD_TRANSLATIONRANGE3:
-      if ( ! expr_discovery->translation ) {
-         bail( expr_discovery );
-      }
-      pop( expr_discovery, 8 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_TRANSLATIONRANGE4:
-      if ( ! expr_discovery->translation ) {
-         bail( expr_discovery );
-      }
-      pop( expr_discovery, 5 );
-      next_pcode( &expr_discovery->range );
-      break;
-   case PCD_TRANSLATIONRANGE5:
+   case OPERAND_TRANSLATIONRANGE:
       if ( ! expr_discovery->translation ) {
          bail( expr_discovery );
+         return;
       }
-      pop( expr_discovery, 6 );
+      pop( expr_discovery, effect->pops );
       next_pcode( &expr_discovery->range );
       break;
-   case PCD_ENDTRANSLATION:
+   case OPERAND_ENDTRANSLATION:
       if ( ! expr_discovery->translation ) {
          bail( expr_discovery );
+         return;
       }
       next_pcode( &expr_discovery->range );
       expr_discovery->done = true;
@@ -1012,6 +842,7 @@ static void examine_operand( struct discovery* discovery,
       }
       else {
          bail( expr_discovery );
+         return;
       }
    }
    if ( expr_discovery->stack_size == 0 &&
@@ -1043,19 +874,27 @@ static void examine_ded_direct( struct discovery* discovery,
 }
 
 static void examine_call_aspec( struct discovery* discovery,
-   struct expr_discovery* expr_discovery ) {
-   i32 id = expr_discovery->range.generic->args->value;
-   pop( expr_discovery, expr_discovery->range.pcode->opcode - PCD_LSPEC1 + 1 );
+   struct expr_discovery* expr_discovery,
+   const struct stack_effect* effect ) {
+   i32 id = expr_discovery->range.generic->args[ 0 ];
+   if ( ! pop( expr_discovery, effect->pops ) ) {
+      return;
+   }
    next_pcode( &expr_discovery->range );
    enum { ASPEC_ACSEXECUTE = 80 };
    if ( id == ASPEC_ACSEXECUTE ) {
       if ( expr_discovery->range.pcode->opcode == PCD_SCRIPTWAIT ) {
-         struct intern_func_note* note = mem_alloc( sizeof( *note ) );
+         // The note is only made once the wait is known to be part of the
+         // expression.
+         if ( ! pop( expr_discovery, 1 ) ) {
+            return;
+         }
+         struct intern_func_note* note = mem_slot_alloc(
+            sizeof( *note ) );
          init_note( &note->note, NOTE_INTERNFUNC );
          note->func = t_find_intern_func( discovery->task,
             INTERNFUNC_ACSEXECUTEWAIT );
-         append_note( expr_discovery->range.pcode->prev, &note->note );
-         pop( expr_discovery, 1 );
+         append_note( PCODE_PREV( expr_discovery->range.pcode ), &note->note );
          next_pcode( &expr_discovery->range );
          note->exit = expr_discovery->range.pcode;
       }
@@ -1069,14 +908,18 @@ static void examine_call_aspec( struct discovery* discovery,
 }
 
 static void examine_call_user( struct discovery* discovery,
-   struct expr_discovery* expr_discovery ) {
+   struct expr_discovery* expr_discovery,
+   const struct stack_effect* effect ) {
    struct func* func = t_find_func( discovery->task,
-      ( u32 ) expr_discovery->range.generic->args->value );
+      ( u32 ) expr_discovery->range.generic->args[ 0 ] );
    if ( ! func ) {
       bail( expr_discovery );
+      return;
    }
-   pop( expr_discovery, func->max_param );
-   if ( expr_discovery->range.pcode->opcode == PCD_CALL ) {
+   if ( ! pop( expr_discovery, func->max_param ) ) {
+      return;
+   }
+   if ( effect->pushes > 0 ) {
       if ( func->return_spec == SPEC_VOID ) {
          t_diag( discovery->task, DIAG_ERR,
             "encounted a `call` instruction whose argument is a function that "
@@ -1089,21 +932,28 @@ static void examine_call_user( struct discovery* discovery,
 }
 
 static void examine_call_ext( struct discovery* discovery,
-   struct expr_discovery* expr_discovery ) {
-   i32 id = expr_discovery->range.generic->args->next->value;
-   pop( expr_discovery, expr_discovery->range.generic->args->value );
-   push( expr_discovery, 1 );
+   struct expr_discovery* expr_discovery,
+   const struct stack_effect* effect ) {
+   i32 id = expr_discovery->range.generic->args[ 1 ];
+   if ( ! pop( expr_discovery, expr_discovery->range.generic->args[ 0 ] ) ) {
+      return;
+   }
+   push( expr_discovery, effect->pushes );
    next_pcode( &expr_discovery->range );
    enum { EXTFUNC_ACSNAMEDEXECUTE = 39 };
    if ( id == EXTFUNC_ACSNAMEDEXECUTE ) {
       if ( expr_discovery->range.pcode->opcode == PCD_DROP &&
-         expr_discovery->range.pcode->next->opcode == PCD_SCRIPTWAITNAMED ) {
-         struct intern_func_note* note = mem_alloc( sizeof( *note ) );
+         PCODE_NEXT( expr_discovery->range.pcode )->opcode ==
+         PCD_SCRIPTWAITNAMED ) {
+         if ( ! pop( expr_discovery, 2 ) ) {
+            return;
+         }
+         struct intern_func_note* note = mem_slot_alloc(
+            sizeof( *note ) );
          init_note( &note->note, NOTE_INTERNFUNC );
          note->func = t_find_intern_func( discovery->task,
             INTERNFUNC_ACSNAMEDEXECUTEWAIT );
-         append_note( expr_discovery->range.pcode->prev, &note->note );
-         pop( expr_discovery, 2 );
+         append_note( PCODE_PREV( expr_discovery->range.pcode ), &note->note );
          next_pcode( &expr_discovery->range );
          next_pcode( &expr_discovery->range );
          note->exit = expr_discovery->range.pcode;
@@ -1121,16 +971,16 @@ static void examine_expr_ifgoto( struct discovery* discovery,
          examine_for( discovery, stmt, expr, &for_discovery );
          return;
       }
-      if ( stmt->range.jump->destination->prev->opcode == PCD_GOTO ) {
+      if ( PCODE_PREV( stmt->range.jump->destination )->opcode == PCD_GOTO ) {
          struct jump_pcode* exit_jump = ( struct jump_pcode* )
-            stmt->range.jump->destination->prev;
-         if ( exit_jump->destination == expr->start ) {
+            PCODE_PREV( stmt->range.jump->destination );
+         if ( exit_jump->destination == expr->start &&
+            closes_loop( discovery, exit_jump ) ) {
             examine_while( discovery, stmt, expr );
             return;
          }
       }
-      if ( stmt->range.jump->destination->obj_pos <
-         stmt->range.pcode->obj_pos ) {
+      if ( closes_loop( discovery, stmt->range.jump ) ) {
          examine_do( discovery, stmt, expr );
       }
    }
@@ -1140,38 +990,41 @@ static void init_for_discovery( struct for_discovery* discovery ) {
    discovery->cond_jump = NULL;
    discovery->post_jump = NULL;
    discovery->exit_jump = NULL;
-   list_init( &discovery->post );
+   vec_init( &discovery->post );
    discovery->discovered = false;
 }
 
 static void discover_for( struct discovery* discovery,
    struct stmt_discovery* stmt, struct expr_discovery* expr,
    struct for_discovery* for_discovery ) {
-   if ( stmt->range.pcode->next->opcode == PCD_GOTO ) {
+   if ( PCODE_NEXT( stmt->range.pcode )->opcode == PCD_GOTO ) {
       struct jump_pcode* exit_jump = ( struct jump_pcode* )
-         stmt->range.pcode->next;
+         PCODE_NEXT( stmt->range.pcode );
       for_discovery->exit_jump = exit_jump;
-      if ( exit_jump->destination->prev->opcode == PCD_GOTO ) {
+      if ( PCODE_PREV( exit_jump->destination )->opcode == PCD_GOTO ) {
          struct jump_pcode* post_jump = ( struct jump_pcode* )
-            exit_jump->destination->prev;
-         if ( post_jump->destination == exit_jump->pcode.next ) {
-            if ( stmt->range.jump->destination->prev->opcode == PCD_GOTO ) {
+            PCODE_PREV( exit_jump->destination );
+         if ( post_jump->destination == PCODE_NEXT( &exit_jump->pcode ) ) {
+            if ( PCODE_PREV( stmt->range.jump->destination )->opcode ==
+               PCD_GOTO ) {
                struct jump_pcode* cond_jump = ( struct jump_pcode* )
-                  stmt->range.jump->destination->prev;
-               if ( cond_jump->destination == expr->start ) {
-                  struct pcode* start = exit_jump->pcode.next;
+                  PCODE_PREV( stmt->range.jump->destination );
+               if ( cond_jump->destination == expr->start &&
+                  closes_loop( discovery, cond_jump ) ) {
+                  struct pcode* start = PCODE_NEXT( &exit_jump->pcode );
                   while ( start != &cond_jump->pcode ) {
                      struct expr_discovery post_expr;
                      init_expr_discovery( &post_expr, start,
-                         cond_jump->pcode.prev );
+                         PCODE_PREV( &cond_jump->pcode ) );
                      discover_expr( discovery, &post_expr );
                      if ( ! post_expr.discovered ) {
                         return;
                      }
-                     struct for_note_post* post = mem_alloc( sizeof( *post ) );
+                     struct for_note_post* post = mem_slot_alloc(
+                        sizeof( *post ) );
                      post->start = post_expr.start;
                      post->end = post_expr.end;
-                     list_append( &for_discovery->post, post );
+                     vec_append( &for_discovery->post, post );
                      start = post_expr.exit;
                   }
                   for_discovery->post_jump = post_jump;
@@ -1187,21 +1040,21 @@ static void discover_for( struct discovery* discovery,
 static void examine_for( struct discovery* discovery,
    struct stmt_discovery* stmt, struct expr_discovery* expr,
    struct for_discovery* for_discovery ) {
-   struct for_note* note = mem_alloc( sizeof( *note ) );
+   struct for_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_FOR );
    note->cond_start = expr->start;
    note->cond_end = expr->end;
-   note->post_start = for_discovery->exit_jump->pcode.next;
-   note->post_end = for_discovery->cond_jump->pcode.prev;
-   note->body_start = for_discovery->cond_jump->pcode.next;
-   note->body_end = for_discovery->post_jump->pcode.prev;
+   note->post_start = PCODE_NEXT( &for_discovery->exit_jump->pcode );
+   note->post_end = PCODE_PREV( &for_discovery->cond_jump->pcode );
+   note->body_start = PCODE_NEXT( &for_discovery->cond_jump->pcode );
+   note->body_end = PCODE_PREV( &for_discovery->post_jump->pcode );
    note->exit = for_discovery->exit_jump->destination;
    note->post = for_discovery->post;
    append_note( expr->start, &note->note );
-   stmt->break_stmt = true;
-   stmt->break_obj_pos = note->exit->obj_pos;
-   stmt->continue_stmt = true;
-   stmt->continue_obj_pos = note->post_start->obj_pos;
+   set_break_target( discovery, stmt, note->body_start, note->body_end,
+      note->exit );
+   set_continue_target( discovery, stmt, note->body_start, note->body_end,
+      note->post_start );
    struct stmt_discovery body;
    init_stmt_discovery( &body, stmt,
       note->body_start,
@@ -1229,10 +1082,11 @@ static void examine_expr_ifnotgoto( struct discovery* discovery,
 static void examine_expr_ifnotgoto_upperaddr( struct discovery* discovery,
    struct stmt_discovery* stmt, struct expr_discovery* expr ) {
    bool while_stmt = false;
-   if ( stmt->range.jump->destination->prev->opcode == PCD_GOTO ) {
+   if ( PCODE_PREV( stmt->range.jump->destination )->opcode == PCD_GOTO ) {
       struct jump_pcode* jump = ( struct jump_pcode* )
-         stmt->range.jump->destination->prev;
-      if ( jump->destination == expr->start ) {
+         PCODE_PREV( stmt->range.jump->destination );
+      if ( jump->destination == expr->start &&
+         closes_loop( discovery, jump ) ) {
          while_stmt = true;
       }
    }
@@ -1247,19 +1101,19 @@ static void examine_expr_ifnotgoto_upperaddr( struct discovery* discovery,
 static void examine_while( struct discovery* discovery,
    struct stmt_discovery* stmt, struct expr_discovery* expr ) {
    struct jump_pcode* cond_jump = ( struct jump_pcode* )
-      stmt->range.jump->destination->prev;
+      PCODE_PREV( stmt->range.jump->destination );
    struct loop_note* note = alloc_loop_note();
    note->cond_start = expr->start;
    note->cond_end = expr->end;
-   note->body_start = stmt->range.pcode->next;
-   note->body_end = cond_jump->pcode.prev;
-   note->exit = cond_jump->pcode.next;
+   note->body_start = PCODE_NEXT( stmt->range.pcode );
+   note->body_end = PCODE_PREV( &cond_jump->pcode );
+   note->exit = PCODE_NEXT( &cond_jump->pcode );
    note->until = ( stmt->range.pcode->opcode == PCD_IFGOTO );
    append_note( expr->start, &note->note );
-   stmt->break_stmt = true;
-   stmt->break_obj_pos = note->exit->obj_pos;
-   stmt->continue_stmt = true;
-   stmt->continue_obj_pos = note->cond_start->obj_pos;
+   set_break_target( discovery, stmt, note->body_start, note->body_end,
+      note->exit );
+   set_continue_target( discovery, stmt, note->body_start, note->body_end,
+      note->cond_start );
    struct stmt_discovery body;
    init_stmt_discovery( &body, stmt,
       note->body_start,
@@ -1273,20 +1127,20 @@ static void examine_if( struct discovery* discovery,
    struct if_note* note = alloc_if_note();
    note->cond_start = expr->start;
    note->cond_end = expr->end;
-   note->body_start = stmt->range.pcode->next;
-   note->body_end = stmt->range.jump->destination->prev;
+   note->body_start = PCODE_NEXT( stmt->range.pcode );
+   note->body_end = PCODE_PREV( stmt->range.jump->destination );
    note->exit = stmt->range.jump->destination;
    if ( ( in_range( &stmt->range, stmt->range.jump->destination ) ||
-      stmt->range.jump->destination == stmt->range.end->next ) &&
-      stmt->range.jump->destination->prev->opcode == PCD_GOTO ) {
+      stmt->range.jump->destination == PCODE_NEXT( stmt->range.end ) ) &&
+      PCODE_PREV( stmt->range.jump->destination )->opcode == PCD_GOTO ) {
       struct jump_pcode* exit_jump = ( struct jump_pcode* )
-         stmt->range.jump->destination->prev;
+         PCODE_PREV( stmt->range.jump->destination );
       if ( ( in_range( &stmt->range, exit_jump->destination ) ||
-         exit_jump->destination == stmt->range.end->next ) && ( exit_jump->destination->obj_pos > exit_jump->pcode.obj_pos ||
+         exit_jump->destination == PCODE_NEXT( stmt->range.end ) ) && ( exit_jump->destination->obj_pos > exit_jump->pcode.obj_pos ||
          exit_jump->destination == stmt->range.jump->destination ) ) {
-         note->else_body_start = exit_jump->pcode.next;
-         note->else_body_end = exit_jump->destination->prev;
-         note->body_end = exit_jump->pcode.prev;
+         note->else_body_start = PCODE_NEXT( &exit_jump->pcode );
+         note->else_body_end = PCODE_PREV( exit_jump->destination );
+         note->body_end = PCODE_PREV( &exit_jump->pcode );
          note->exit = exit_jump->destination;
       }
    }
@@ -1307,7 +1161,7 @@ static void examine_if( struct discovery* discovery,
 }
 
 static struct if_note* alloc_if_note( void ) {
-   struct if_note* note = mem_alloc( sizeof( *note ) );
+   struct if_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_IF );
    note->cond_start = NULL;
    note->cond_end = NULL;
@@ -1340,13 +1194,13 @@ static void examine_do( struct discovery* discovery,
    note->cond_start = expr->start;
    note->cond_end = expr->end;
    note->body_start = stmt->range.jump->destination;
-   note->body_end = expr->start->prev;
-   note->exit = stmt->range.pcode->next;
+   note->body_end = PCODE_PREV( expr->start );
+   note->exit = PCODE_NEXT( stmt->range.pcode );
    note->until = ( stmt->range.pcode->opcode == PCD_IFNOTGOTO );
-   stmt->break_stmt = true;
-   stmt->break_obj_pos = note->exit->obj_pos;
-   stmt->continue_stmt = true;
-   stmt->continue_obj_pos = note->cond_start->obj_pos;
+   set_break_target( discovery, stmt, note->body_start, note->body_end,
+      note->exit );
+   set_continue_target( discovery, stmt, note->body_start, note->body_end,
+      note->cond_start );
    struct stmt_discovery body;
    init_stmt_discovery( &body, stmt,
       note->body_start,
@@ -1357,7 +1211,7 @@ static void examine_do( struct discovery* discovery,
 }
 
 static struct do_note* alloc_do( void ) {
-   struct do_note* note = mem_alloc( sizeof( *note ) );
+   struct do_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_DO );
    note->cond_start = NULL;
    note->cond_end = NULL;
@@ -1383,12 +1237,12 @@ static void examine_expr_goto( struct discovery* discovery,
 
 static void examine_switch( struct discovery* discovery,
    struct stmt_discovery* stmt, struct expr_discovery* expr ) {
-   struct switch_note* note = mem_alloc( sizeof( *note ) );
+   struct switch_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_SWITCH );
    note->cond_start = expr->start;
    note->cond_end = expr->end;
-   note->body_start = stmt->range.pcode->next;
-   note->body_end = stmt->range.jump->destination->prev->prev;
+   note->body_start = PCODE_NEXT( stmt->range.pcode );
+   note->body_end = PCODE_PREV( PCODE_PREV( stmt->range.jump->destination ) );
    note->case_start = NULL;
    note->case_end = NULL;
    note->sorted_jump = NULL;
@@ -1412,43 +1266,51 @@ static void examine_switch( struct discovery* discovery,
       }
    }
    next_pcode( &stmt->range );
+   // The body ends with a jump over the case table, to the exit. When the
+   // body jumps to the pcode after the case table, that pcode is the exit,
+   // even when it is a goto. Otherwise, a goto there jumps to the default
+   // case.
    struct pcode* default_case = NULL;
    if ( stmt->range.pcode->opcode == PCD_GOTO &&
-      in_range( &stmt->range, stmt->range.jump->destination ) ) {
+      in_range( &stmt->range, stmt->range.jump->destination ) &&
+      ! jumped_to_from( discovery, stmt->range.pcode, note->body_start,
+         PCODE_NEXT( note->body_end ) ) ) {
       default_case = stmt->range.jump->destination;
       next_pcode( &stmt->range );
    }
    note->exit = stmt->range.pcode;
-   stmt->break_stmt = true;
-   stmt->break_obj_pos = note->exit->obj_pos;
+   set_break_target( discovery, stmt, note->body_start, note->body_end,
+      note->exit );
    struct stmt_discovery body;
    init_stmt_discovery( &body, stmt,
       note->body_start,
       note->body_end );
    examine_block( discovery, &body );
    if ( default_case ) {
-      struct case_note* case_note = mem_alloc( sizeof( *note ) );
+      struct case_note* case_note = mem_slot_alloc(
+         sizeof( *case_note ) );
       init_note( &case_note->note, NOTE_CASE );
       case_note->value = 0;
       case_note->default_case = true;
       append_note( default_case, &case_note->note );
    }
    if ( note->sorted_jump ) {
-      struct casejump_pcode* jump = note->sorted_jump->head;
-      while ( jump ) {
-         struct case_note* case_note = mem_alloc( sizeof( *note ) );
+      for ( i32 i = 0; i < note->sorted_jump->count; ++i ) {
+         struct casejump_pcode* jump = &note->sorted_jump->cases[ i ];
+         struct case_note* case_note = mem_slot_alloc(
+            sizeof( *case_note ) );
          init_note( &case_note->note, NOTE_CASE );
          case_note->value = jump->value;
          case_note->default_case = false;
          append_note( jump->destination, &case_note->note );
-         jump = jump->next;
       }
    }
    else if ( note->case_start ) {
       struct pcode_range range;
       init_range( &range, note->case_start, note->case_end );
       while ( have_pcode( &range ) ) {
-         struct case_note* case_note = mem_alloc( sizeof( *note ) );
+         struct case_note* case_note = mem_slot_alloc(
+            sizeof( *case_note ) );
          init_note( &case_note->note, NOTE_CASE );
          case_note->value = range.casejump->value;
          case_note->default_case = false;
@@ -1460,18 +1322,18 @@ static void examine_switch( struct discovery* discovery,
 
 static void examine_returnval( struct discovery* discovery,
    struct stmt_discovery* stmt, struct expr_discovery* expr ) {
-   struct return_note* note = mem_alloc( sizeof( *note ) );
+   struct return_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_RETURN );
    note->expr_start = expr->start;
    note->expr_end = expr->end;
-   note->exit = stmt->range.pcode->next;
+   note->exit = PCODE_NEXT( stmt->range.pcode );
    append_note( expr->start, &note->note );
    next_pcode( &stmt->range );
 }
 
 static void examine_expr_stmt( struct stmt_discovery* stmt,
    struct expr_discovery* expr ) {
-   struct expr_stmt_note* note = mem_alloc( sizeof( *note ) );
+   struct expr_stmt_note* note = mem_slot_alloc( sizeof( *note ) );
    init_note( &note->note, NOTE_EXPRSTMT );
    note->expr_start = expr->start;
    note->expr_end = expr->end;
@@ -1479,7 +1341,7 @@ static void examine_expr_stmt( struct stmt_discovery* stmt,
    append_note( expr->start, &note->note );
    seek_pcode( &stmt->range, note->exit );
    if ( stmt->range.pcode->opcode == PCD_DROP ) {
-      note->exit = note->exit->next;
+      note->exit = PCODE_NEXT( note->exit );
       next_pcode( &stmt->range );
    }
 }
@@ -8,19 +8,83 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <setjmp.h>
+#include <ctype.h>
 
 #include "task.h"
 #include "pcode.h"
 
-enum { DEFAULT_SCRIPT_VARS = 20 };
+enum {
+   DEFAULT_SCRIPT_VARS = 20,
+   HEADER_SIZE = 8
+};
+
+struct chunk_header {
+   char name[ 4 ];
+   u32 size;
+};
+
+// Entry of the directory of scripts found in object files that begin with the
+// ACS0 header.
+struct directory_entry {
+   u32 number;
+   u32 offset;
+   u32 num_param;
+};
+
+struct chunk_entry {
+   const u8* data;
+   u32 tag;
+   u32 size;
+   // Index of the next chunk with the same name, or -1.
+   i32 next;
+};
+
+// Scratch space that the pcode of a script or function is decoded into. The
+// space is reused for every body, and the decoded pcode is then copied out in
+// arrays of the exact size.
+struct pcode_buffer {
+   union pcode_slot* slots;
+   i32* args;
+   struct casejump_pcode* cases;
+   u32 num_slots;
+   u32 slots_capacity;
+   u32 num_args;
+   u32 args_capacity;
+   u32 num_cases;
+   u32 cases_capacity;
+   // Maps the object file position of each instruction in the body, relative
+   // to the start of the body, to the decoded pcode. Positions that are not at
+   // the start of an instruction map to NULL.
+   struct pcode** targets;
+   u32 targets_capacity;
+};
+
+enum { MAX_OPERANDS = 6 };
+
+// Sizes of the operands of an instruction, in the encoding used by the object
+// file being loaded.
+struct operand_layout {
+   i32 argc;
+   // Total size of the operands.
+   i32 size;
+   u8 sizes[ MAX_OPERANDS ];
+   bool supported;
+};
 
 struct loader {
    struct task* task;
+   struct operand_layout operand_layouts[ PCD_TOTAL ];
+   struct chunk_entry* chunks;
+   u32 num_chunks;
+   i32* chunk_slots;
+   u32 num_chunk_slots;
    const u8* object_data;
    const u8* object_data_end;
    u32 object_size;
    u32 format;
    u32 directory_offset;
+   u32 num_directory_entries;
    u32 chunk_offset;
    u32 chunk_end;
    u32 string_offset;
@@ -29,18 +93,64 @@ struct loader {
    bool small_code;
 };
 
+enum {
+   MAX_DECODE_WORKERS = 16,
+   // Objects with less pcode than this are decoded by the calling thread.
+   MIN_PARALLEL_DECODE_SIZE = 256 * 1024
+};
+
+// A script or function body waiting to be decoded.
+struct body_job {
+   const u8* data;
+   const u8* data_end;
+   struct pcode** start;
+   struct pcode** end;
+   struct jump_index* jumps;
+};
+
+// Decodes every n-th body, starting at the body of the worker's index. The
+// bodies are assigned by position, so which worker decodes which body does not
+// depend on how the threads are scheduled.
+struct decode_worker {
+   struct loader* loader;
+   struct body_job* jobs;
+   u32 num_jobs;
+   u32 job;
+   u32 job_step;
+   struct pcode_buffer buffer;
+   struct mem_arena* region;
+   struct thread thread;
+   jmp_buf bail;
+   struct str error;
+   i32 error_flags;
+   bool failed;
+};
+
+// Number of pcode, arguments, and cases in a body, counted when the body is
+// validated.
+struct body_layout {
+   u32 num_pcode;
+   u32 num_args;
+   u32 num_cases;
+};
+
 struct pcode_reading {
+   struct decode_worker* worker;
    const u8* data;
    const u8* data_end;
-   struct pcode* head;
-   struct pcode* tail;
+   struct pcode_buffer* buffer;
+   struct pcode* start;
+   struct pcode* end;
+   u32 start_obj_pos;
+   u32 end_obj_pos;
    u32 obj_pos;
    i32 opcode;
 };
 
 struct patch {
-   struct pcode* begin;
-   struct pcode* end;
+   struct pcode** targets;
+   u32 start_obj_pos;
+   u32 size;
 };
 
 struct chunk {
@@ -49,14 +159,15 @@ struct chunk {
    const u8* start;
    const u8* end;
    u32 size;
+   i32 entry;
    bool found;
 };
 
 static void init_loader( struct loader* loader, struct task* task );
 static void load_module( struct loader* loader );
-static void read_file( struct loader* loader );
-static bool read_file_data( struct loader* loader, FILE* fh );
+static void read_input( struct loader* loader );
 static void determine_format( struct loader* loader );
+static void validate_directory( struct loader* loader );
 static void expect_data( struct loader* loader, const u8* start, u32 size );
 static void expect_offset_in_object_file( struct loader* loader, u32 offset );
 static u32 data_left( struct loader* loader, const u8* data );
@@ -65,9 +176,15 @@ static bool offset_in_range( struct loader* loader, const u8* start,
 static bool offset_in_object_file( struct loader* loader, u32 offset );
 static void read_object( struct loader* loader );
 static void read_acse_object( struct loader* loader );
+static void index_chunks( struct loader* loader );
+static i32* find_chunk_slot( struct loader* loader, u32 tag );
+static void show_chunk( struct loader* loader, struct chunk* chunk,
+   i32 entry );
 static void read_scripts( struct loader* loader );
 static void read_sptr( struct loader* loader );
 static struct script* alloc_script( void );
+static void init_jump_index( struct jump_index* index );
+static void init_cached_body( struct cached_body* body );
 static void read_sflg( struct loader* loader );
 static u32 set_script_flag( struct script* script, u32 flags, u32 flag );
 static void read_script_space( struct loader* loader );
@@ -76,17 +193,54 @@ static void reserve_script_space( struct script* script, u32 num_vars );
 static void reserve_default_script_space( struct loader* loader );
 static void read_script_names( struct loader* loader );
 static bool chunk_offset_in_chunk( struct chunk* chunk, u32 offset );
+static void expect_name_table( struct loader* loader, struct chunk* chunk,
+   const u8* data, u32 count );
+static const struct istr* read_chunk_name( struct loader* loader,
+   struct chunk* chunk, u32 index, u32 offset );
 static void read_funcs( struct loader* loader );
 static void read_func( struct loader* loader );
 static void read_fnam( struct loader* loader );
 static void append_object( struct loader* loader, struct node* object );
 static u32 object_offset( struct node* node );
+static u32 object_end_offset( struct node* node );
+static void apply_selection( struct loader* loader );
+static void select_script( struct loader* loader, const char* value );
+static void select_func( struct loader* loader, const char* value );
 static void determine_end_of_objects( struct loader* loader );
-static void read_func_body_list( struct loader* loader );
-static void read_func_body( struct loader* loader, struct func* func );
+static void validate_body_ranges( struct loader* loader );
+static void read_body_list( struct loader* loader );
+static u32 add_called_funcs( struct loader* loader, struct body_job* jobs,
+   u32 num_jobs, struct body_job* called_jobs );
+static void add_func_job( struct loader* loader, struct body_job* job,
+   struct func* func );
+static void decode_bodies( struct loader* loader, struct body_job* jobs,
+   u32 num_jobs );
+static void add_body_job( struct loader* loader, struct body_job* job,
+   u32 offset, u32 end_offset, struct pcode** start, struct pcode** end,
+   struct jump_index* jumps );
+static u32 count_decode_workers( struct loader* loader, u32 num_jobs,
+   u64 size );
+static void init_decode_worker( struct loader* loader,
+   struct decode_worker* worker, struct body_job* jobs, u32 num_jobs,
+   u32 index, u32 num_workers );
+static void run_decode_worker( void* data );
+static void read_body( struct decode_worker* worker, struct body_job* job );
+static void validate_body( struct loader* loader,
+   struct pcode_reading* reading, struct body_layout* layout );
+static u64 validate_pcode( struct loader* loader,
+   struct pcode_reading* reading, const u8* data, u64 left,
+   struct body_layout* layout );
+static void report_decode_error( struct loader* loader,
+   struct decode_worker* workers, u32 num_workers );
+static void decode_error( struct pcode_reading* reading, i32 flags,
+   const char* format, ... );
 static void read_strings( struct loader* loader );
 static void reserve_strings( struct loader* loader, u32 num_strings );
-static u8 decrypt_ch( u32 string_offset, u32 ch_pos, u8 ch );
+static u32 read_string_offset( struct task* task, u32 index );
+static const struct istr* decode_string( struct task* task, const u8* data,
+   u32 size, u32 offset, bool encrypted, struct str* buffer );
+static void decrypt_block( u8* output, const u8* input, u32 string_offset,
+   u32 pos, u32 count );
 static void expect_chunk_data( struct loader* loader, struct chunk* chunk,
    const u8* start, u32 size );
 static u32 chunk_data_left( struct chunk* chunk, const u8* data );
@@ -118,50 +272,67 @@ static void read_script_list( struct loader* loader );
 static void read_script( struct loader* loader );
 static void read_string_table( struct loader* loader );
 static void read_script_pcode( struct loader* loader, struct script* script );
-static void read_script_body_list( struct loader* loader );
-static void read_script_body( struct loader* loader, struct script* script );
-static void init_pcode_reading( struct pcode_reading* reading, const u8* data,
-   const u8* data_end );
-static void append_pcode( struct pcode_reading* reading,
-   struct pcode* pcode );
+static void init_pcode_reading( struct pcode_reading* reading,
+   struct decode_worker* worker, const u8* data, const u8* data_end );
+static void init_pcode_buffer( struct pcode_buffer* buffer );
+static void reserve_pcode_buffer( struct pcode_buffer* buffer,
+   struct body_layout* layout );
+static union pcode_slot* append_pcode( struct pcode_reading* reading,
+   i32 opcode );
+static void* reserve_buffer( void* items, u32* capacity, u32 count,
+   size_t item_size );
 static void read_pcode_list( struct loader* loader,
    struct pcode_reading* reading );
+static void copy_pcode_list( struct pcode_reading* reading );
+static void* copy_buffer( const void* items, size_t size );
 static bool have_pcode( struct pcode_reading* reading );
 static void read_pcode( struct loader* loader, struct pcode_reading* reading );
 static void read_opcode( struct loader* loader,
    struct pcode_reading* reading );
+static u32 opcode_size( struct loader* loader, const u8* data );
+static u32 decode_opcode( struct loader* loader, const u8* data,
+   i32* opcode );
 static void read_arg( struct pcode_reading* reading, i32* value );
 static void read_jump( struct pcode_reading* reading );
 static void read_casejump( struct pcode_reading* reading );
 static void read_sortedcasejump( struct loader* loader,
    struct pcode_reading* reading );
-static void append_casejump( struct sortedcasejump_pcode* jump,
-   struct casejump_pcode* case_jump );
+static struct casejump_pcode* append_case( struct pcode_reading* reading,
+   struct sortedcasejump_pcode* jump );
 static void read_pushbytes( struct loader* loader,
    struct pcode_reading* reading );
 static void read_generic( struct loader* loader,
    struct pcode_reading* reading );
-static struct generic_pcode* alloc_generic_pcode( i32 opcode, u32 obj_pos );
-static void read_generic_arg( struct loader* loader,
-   struct pcode_reading* reading, struct generic_pcode* generic,
+static struct generic_pcode* append_generic_pcode(
+   struct pcode_reading* reading, i32 opcode );
+static i32 read_operand( struct pcode_reading* reading, i32 size );
+static void init_operand_layouts( struct loader* loader );
+static i32 get_operand_size( struct loader* loader, i32 opcode,
    i32 arg_number );
-static struct generic_pcode_arg* alloc_generic_pcode_arg( void );
-static void append_arg( struct generic_pcode* generic,
-   struct generic_pcode_arg* arg );
+static void append_arg( struct pcode_reading* reading,
+   struct generic_pcode* generic, i32 value );
+static i32* reserve_args( struct pcode_reading* reading,
+   struct generic_pcode* generic, i32 count );
 static void init_pcode( struct pcode* pcode, i32 opcode );
-static void patch( struct task* task );
-static void patch_scripts( struct task* task );
-static void patch_funcs( struct task* task );
-static void init_patch( struct patch* patch, struct pcode* begin,
-   struct pcode* end );
-static void patch_script( struct patch* patch );
-static void patch_jump( struct patch* patch, struct jump_pcode* jump );
-static void patch_casejump( struct patch* patch,
+static void map_targets( struct pcode_reading* reading );
+static void patch_body( struct pcode_reading* reading );
+static void init_patch( struct patch* patch, struct pcode_reading* reading );
+static void patch_jump( struct pcode_reading* reading, struct patch* patch,
+   struct jump_pcode* jump );
+static void patch_casejump( struct pcode_reading* reading, struct patch* patch,
    struct casejump_pcode* jump );
-static void patch_sortedcasejump( struct patch* patch,
+static void patch_sortedcasejump( struct pcode_reading* reading, struct patch* patch,
    struct sortedcasejump_pcode* jump );
-static struct pcode* find_destination( struct patch* patch,
-   struct pcode* jump, i32 obj_pos );
+static struct pcode* find_destination( struct pcode_reading* reading,
+   struct patch* patch, struct pcode* jump, i32 obj_pos );
+static void index_jumps( struct pcode_reading* reading,
+   struct jump_index* index );
+static void visit_jumps( struct pcode_reading* reading,
+   struct jump_index* index, bool fill );
+static void add_jump( struct jump_index* index, struct pcode* source,
+   struct pcode* destination, bool fill );
+static bool find_jump_slot( struct jump_index* index, struct pcode* pcode,
+   u32* slot );
 static void show_script( struct task* task, struct script* script );
 static void diag( struct loader* loader, u32 flags, ... );
 static void bail( struct loader* loader );
@@ -177,11 +348,16 @@ void t_load( struct task* task ) {
 
 static void init_loader( struct loader* loader, struct task* task ) {
    loader->task = task;
+   loader->chunks = NULL;
+   loader->num_chunks = 0;
+   loader->chunk_slots = NULL;
+   loader->num_chunk_slots = 0;
    loader->object_data = NULL;
    loader->object_data_end = NULL;
    loader->object_size = 0;
    loader->format = FORMAT_UNKNOWN;
    loader->directory_offset = 0;
+   loader->num_directory_entries = 0;
    loader->chunk_offset = 0;
    loader->chunk_end = 0;
    loader->string_offset = 0;
@@ -191,63 +367,29 @@ static void init_loader( struct loader* loader, struct task* task ) {
 }
 
 static void load_module( struct loader* loader ) {
-   read_file( loader );
+   read_input( loader );
    determine_format( loader );
+   validate_directory( loader );
+   init_operand_layouts( loader );
    read_object( loader );
-   patch( loader->task );
 }
 
-static void read_file( struct loader* loader ) {
-   FILE* fh = fopen( loader->task->options->object_file, "rb" );
-   if ( ! fh ) {
-      diag( loader, DIAG_ERR,
-         "failed to open object file: \"%s\"",
-         loader->task->options->object_file );
-      t_bail( loader->task );
-   }
-   bool success = read_file_data( loader, fh );
-   fclose( fh );
-   if ( ! success ) {
-      bail( loader );
-   }
-}
-
-static bool read_file_data( struct loader* loader, FILE* fh ) {
-   fseek( fh, 0, SEEK_END );
-   long tell_result = ftell( fh );
-   if ( ! ( tell_result >= 0 ) ) {
-      diag( loader, DIAG_ERR,
-         "failed to seek to end of object file" );
-      return false;
-   }
-   size_t size = ( size_t ) tell_result;
-   i32 seek_result = fseek( fh, 0, SEEK_SET );
-   if ( seek_result != 0 ) {
-      diag( loader, DIAG_ERR,
-         "failed to seek to beginning of object file" );
-      return false;
-   }
+// The object is part of a file mapped into memory, so the object data points
+// directly into the file and is not copied.
+static void read_input( struct loader* loader ) {
+   struct object_input* input = &loader->task->input;
    STATIC_ASSERT( SIZE_MAX > UINT_MAX );
-   if ( size > UINT_MAX ) {
+   if ( input->size > UINT_MAX ) {
       diag( loader, DIAG_ERR,
          "object file is %zu bytes, but the maximum supported object file "
-         "size is %d bytes", size, UINT_MAX );
-      return false;
+         "size is %u bytes", input->size, UINT_MAX );
+      bail( loader );
    }
-   u32 object_size = ( u32 ) size;
-   if ( object_size > 0 ) {
-      u8* data = mem_alloc( sizeof( data[ 0 ] ) * object_size );
-      size_t num_read = fread( data, sizeof( data[ 0 ] ), object_size, fh );
-      if ( num_read != object_size ) {
-         diag( loader, DIAG_ERR,
-            "failed to read %zu byte of object file", object_size - num_read );
-         return false;
-      }
-      loader->object_data = data;
-      loader->object_data_end = data + object_size;
-      loader->object_size = object_size;
+   if ( input->size > 0 ) {
+      loader->object_data = input->data;
+      loader->object_data_end = input->data + input->size;
+      loader->object_size = ( u32 ) input->size;
    }
-   return true;
 }
 
 static void determine_format( struct loader* loader ) {
@@ -299,6 +441,28 @@ static void determine_format( struct loader* loader ) {
    }
 }
 
+// Only object files that begin with the ACS0 header have a directory. In an
+// ACSE object file wrapped in such a header, the directory is usually empty.
+static void validate_directory( struct loader* loader ) {
+   if ( ! ( loader->format == FORMAT_ZERO || loader->indirect_format ) ) {
+      return;
+   }
+   expect_offset_in_object_file( loader, loader->directory_offset );
+   const u8* data = loader->object_data + loader->directory_offset;
+   i32 count = 0;
+   expect_data( loader, data, sizeof( count ) );
+   memcpy( &count, data, sizeof( count ) );
+   data += sizeof( count );
+   if ( count < 0 || data_left( loader, data ) /
+      sizeof( struct directory_entry ) < ( u32 ) count ) {
+      diag( loader, DIAG_ERR,
+         "directory gives a number of scripts (%d) that cannot possibly fit "
+         "in the object file", count );
+      bail( loader );
+   }
+   loader->num_directory_entries = ( u32 ) count;
+}
+
 static u32 data_left( struct loader* loader, const u8* data ) {
    return ( u32 ) ( loader->object_data_end - data );
 }
@@ -350,17 +514,11 @@ static void read_object( struct loader* loader ) {
 }
 
 static void read_acse_object( struct loader* loader ) {
-   const u8* data = loader->object_data + loader->directory_offset;
-   i32 num_scripts = 0;
-   memcpy( &num_scripts, data, sizeof( num_scripts ) );
-   data += sizeof( num_scripts );
-   if ( num_scripts > 0 ) {
-      struct {
-         u32 number;
-         u32 offset;
-         u32 num_param;
-      } entry;
-      memcpy( &entry, data, sizeof( entry ) );
+   index_chunks( loader );
+   if ( loader->num_directory_entries > 0 ) {
+      struct directory_entry entry;
+      memcpy( &entry, loader->object_data + loader->directory_offset +
+         sizeof( i32 ), sizeof( entry ) );
       loader->end_offset = entry.offset;
    }
    else {
@@ -368,9 +526,10 @@ static void read_acse_object( struct loader* loader ) {
    }
    read_scripts( loader );
    read_funcs( loader );
+   apply_selection( loader );
    determine_end_of_objects( loader );
-   read_script_body_list( loader );
-   read_func_body_list( loader );
+   validate_body_ranges( loader );
+   read_body_list( loader );
    read_strings( loader );
    read_map_vars( loader );
    read_local_arrays( loader );
@@ -381,7 +540,7 @@ static void read_acse_object( struct loader* loader ) {
    read_mstr( loader );
    read_astr( loader );
    // #nowadauthor creates a dummy directory that is empty for BEHAVIOR lumps.
-   if ( ! loader->task->importable && num_scripts > 0 ) {
+   if ( ! loader->task->importable && loader->num_directory_entries > 0 ) {
       loader->task->wadauthor = true;
    }
 }
@@ -390,59 +549,96 @@ static void init_chunk( struct chunk* chunk, const char* name ) {
    chunk->name = name;
    chunk->data = NULL;
    chunk->size = 0;
+   chunk->entry = -1;
    chunk->found = false;
 } 
 
-static void find_chunk( struct loader* loader, struct chunk* chunk ) {
-   const u8* data = ( const u8* ) loader->object_data + loader->chunk_offset;
-   const u8* data_end = ( const u8* ) loader->object_data + loader->chunk_end;
-   while ( data < data_end ) {
-      struct {
-         char name[ 4 ];
-         u32 size;
-      } header;
+// Walks the chunk area once and records where each chunk is. Chunks with the
+// same name are linked together, in the order they appear in the object file,
+// and the first chunk of each name can be found through a hash table.
+static void index_chunks( struct loader* loader ) {
+   struct mem_arena* arena = mem_select_arena( &loader->task->load_region );
+   const u8* data = loader->object_data + loader->chunk_offset;
+   const u8* data_end = loader->object_data + loader->chunk_end;
+   u32 capacity = 0;
+   while ( data < data_end &&
+      ( size_t ) ( data_end - data ) >= sizeof( struct chunk_header ) ) {
+      struct chunk_header header;
       memcpy( &header, data, sizeof( header ) );
       data += sizeof( header );
-      if ( memcmp( header.name, chunk->name, sizeof( header.name ) ) == 0 ) {
-         chunk->size = header.size;
-         chunk->data = data;
-         chunk->start = data;
-         chunk->end = chunk->data + chunk->size;
-         chunk->found = true;
-         return;
+      if ( header.size > ( size_t ) ( data_end - data ) ) {
+         diag( loader, DIAG_ERR,
+            "%.4s chunk is %u bytes, but only %u bytes are left in the "
+            "chunk section", header.name, header.size,
+            ( u32 ) ( data_end - data ) );
+         bail( loader );
+      }
+      if ( loader->num_chunks == capacity ) {
+         capacity = capacity ? capacity * 2 : 32;
+         loader->chunks = mem_realloc( loader->chunks,
+            sizeof( loader->chunks[ 0 ] ) * capacity );
       }
+      struct chunk_entry* entry = &loader->chunks[ loader->num_chunks ];
+      memcpy( &entry->tag, header.name, sizeof( entry->tag ) );
+      entry->size = header.size;
+      entry->data = data;
+      entry->next = -1;
+      ++loader->num_chunks;
       data += header.size;
    }
-   chunk->found = false;
+   // Keep the table at most half full.
+   loader->num_chunk_slots = 32;
+   while ( loader->num_chunk_slots < loader->num_chunks * 2 ) {
+      loader->num_chunk_slots *= 2;
+   }
+   loader->chunk_slots = mem_alloc( sizeof( loader->chunk_slots[ 0 ] ) *
+      loader->num_chunk_slots );
+   for ( u32 i = 0; i < loader->num_chunk_slots; ++i ) {
+      loader->chunk_slots[ i ] = -1;
+   }
+   // Insert the chunks from last to first, so each chunk is prepended to the
+   // list of chunks that share its name.
+   for ( u32 i = loader->num_chunks; i-- > 0; ) {
+      i32* slot = find_chunk_slot( loader, loader->chunks[ i ].tag );
+      loader->chunks[ i ].next = *slot;
+      *slot = ( i32 ) i;
+   }
+   mem_select_arena( arena );
 }
 
-static void find_chunk_from_offset( struct loader* loader,
-   struct chunk* chunk, const u8* offset ) {
-   const u8* data = offset ? offset :
-      ( const u8* ) loader->object_data + loader->chunk_offset;
-   const u8* data_end = ( const u8* ) loader->object_data + loader->chunk_end;
-   while ( data < data_end ) {
-      struct {
-         char name[ 4 ];
-         u32 size;
-      } header;
-      memcpy( &header, data, sizeof( header ) );
-      data += sizeof( header );
-      if ( memcmp( header.name, chunk->name, sizeof( header.name ) ) == 0 ) {
-         chunk->size = header.size;
-         chunk->data = data;
-         chunk->start = data;
-         chunk->end = chunk->data + chunk->size;
-         chunk->found = true;
-         return;
-      }
-      data += header.size;
+static i32* find_chunk_slot( struct loader* loader, u32 tag ) {
+   u32 mask = loader->num_chunk_slots - 1;
+   u32 i = ( tag * 2654435761u ) & mask;
+   while ( loader->chunk_slots[ i ] != -1 &&
+      loader->chunks[ loader->chunk_slots[ i ] ].tag != tag ) {
+      i = ( i + 1 ) & mask;
    }
-   chunk->found = false;
+   return &loader->chunk_slots[ i ];
+}
+
+static void find_chunk( struct loader* loader, struct chunk* chunk ) {
+   u32 tag = 0;
+   memcpy( &tag, chunk->name, sizeof( tag ) );
+   show_chunk( loader, chunk, *find_chunk_slot( loader, tag ) );
 }
 
 static void next_chunk( struct loader* loader, struct chunk* chunk ) {
-   find_chunk_from_offset( loader, chunk, chunk->data + chunk->size );
+   show_chunk( loader, chunk, loader->chunks[ chunk->entry ].next );
+}
+
+static void show_chunk( struct loader* loader, struct chunk* chunk,
+   i32 entry ) {
+   if ( entry != -1 ) {
+      chunk->size = loader->chunks[ entry ].size;
+      chunk->data = loader->chunks[ entry ].data;
+      chunk->start = chunk->data;
+      chunk->end = chunk->data + chunk->size;
+      chunk->entry = entry;
+      chunk->found = true;
+   }
+   else {
+      chunk->found = false;
+   }
 }
 
 static void read_scripts( struct loader* loader ) {
@@ -475,7 +671,7 @@ static void read_sptr( struct loader* loader ) {
       script->type = entry.type;
       script->num_param = entry.num_param;
       script->offset = entry.offset;
-      list_append( &loader->task->scripts, script );
+      vec_append( &loader->task->scripts, script );
       append_object( loader, &script->node );
    }
 }
@@ -486,7 +682,8 @@ static struct script* alloc_script( void ) {
    script->body_start = NULL;
    script->body_end = NULL;
    script->vars = NULL;
-   str_init( &script->name );
+   script->arrays = NULL;
+   script->name = NULL;
    script->number = 0;
    script->offset = 0;
    script->end_offset = 0;
@@ -495,10 +692,29 @@ static struct script* alloc_script( void ) {
    script->flags = 0;
    script->num_vars = 0;
    script->body = NULL;
+   init_jump_index( &script->jumps );
+   init_cached_body( &script->cache );
    script->named_script = false;
+   script->selected = true;
    return script;
 }
 
+static void init_jump_index( struct jump_index* index ) {
+   index->start = NULL;
+   index->targets = NULL;
+   index->first_source = NULL;
+   index->sources = NULL;
+   index->num_slots = 0;
+}
+
+static void init_cached_body( struct cached_body* body ) {
+   body->key = 0;
+   body->text = NULL;
+   body->reusable = false;
+   body->calls_aspec = false;
+   body->calls_ext = false;
+}
+
 static void read_sflg( struct loader* loader ) {
    struct chunk chunk;
    init_chunk( &chunk, "SFLG" );
@@ -543,27 +759,19 @@ static u32 set_script_flag( struct script* script, u32 flags, u32 flag ) {
 }
 
 struct script* t_find_script( struct task* task, i32 number ) {
-   struct list_iter i;
-   list_iterate( &task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      struct script* script = list_data( &i );
+   for ( u32 i = 0; i < vec_size( &task->scripts ); ++i ) {
+      struct script* script = vec_at( &task->scripts, i );
       if ( script->number == number ) {
          return script;
       }
-      list_next( &i );
    }
    return NULL;
 }
 
 struct func* t_find_func( struct task* task, u32 index ) {
-   struct list_iter i;
-   list_iterate( &task->funcs, &i );
-   while ( ! list_end( &i ) ) {
-      struct func* func = list_data( &i );
-      if ( func->more.user->index == index ) {
-         return func;
-      }
-      list_next( &i );
+   // Functions are appended in the order of their index.
+   if ( index < vec_size( &task->funcs ) ) {
+      return vec_at( &task->funcs, index );
    }
    return NULL;
 }
@@ -610,14 +818,11 @@ static void reserve_script_space( struct script* script, u32 num_vars ) {
 }
 
 static void reserve_default_script_space( struct loader* loader ) {
-   struct list_iter i;
-   list_iterate( &loader->task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      struct script* script = list_data( &i );
+   for ( u32 i = 0; i < vec_size( &loader->task->scripts ); ++i ) {
+      struct script* script = vec_at( &loader->task->scripts, i );
       if ( ! script->vars ) {
          reserve_script_space( script, DEFAULT_SCRIPT_VARS );
       }
-      list_next( &i );
    }
 }
 
@@ -644,15 +849,11 @@ static void read_script_names( struct loader* loader ) {
       u32 offset = 0;
       memcpy( &offset, data, sizeof( offset ) );
       data += sizeof( offset );
-      if ( ! chunk_offset_in_chunk( &chunk, offset ) ) {
-         diag( loader, DIAG_ERR,
-            "string offset in position %d of %s chunk points outside of "
-            "chunk data range", i, chunk.name );
-         bail( loader );
-      }
+      const struct istr* name = read_chunk_name( loader, &chunk, i,
+         offset );
       struct script* script = t_find_script( loader->task, script_number );
       if ( script ) {
-         str_append( &script->name, ( const char* ) chunk.data + offset );
+         script->name = name;
          script->named_script = true;
       }
       --script_number;
@@ -691,6 +892,14 @@ static void read_func( struct loader* loader ) {
          func->return_spec = SPEC_INT;
       }
       struct func_user* user = mem_alloc( sizeof( *user ) );
+      user->start = NULL;
+      user->end = NULL;
+      user->body = NULL;
+      user->vars = NULL;
+      user->arrays = NULL;
+      init_jump_index( &user->jumps );
+      init_cached_body( &user->cache );
+      user->selected = true;
       user->offset = entry.offset;
       user->end_offset = entry.offset;
       user->index = i;
@@ -703,7 +912,7 @@ static void read_func( struct loader* loader ) {
             user->vars[ i ] = NULL;
          }
       }
-      list_append( &loader->task->funcs, func );
+      vec_append( &loader->task->funcs, func );
       append_object( loader, &func->node );
    }
 }
@@ -717,30 +926,64 @@ static void read_fnam( struct loader* loader ) {
    }
    const u8* data = chunk.data;
    i32 count = 0;
+   expect_chunk_data( loader, &chunk, data, sizeof( count ) );
    memcpy( &count, data, sizeof( count ) );
    data += sizeof( count );
-   struct list_iter i;
-   list_iterate( &loader->task->funcs, &i );
-   i32 index = 0;
-   while ( ! list_end( &i ) && index < count ) {
-      i32 offset = 0;
+   // Names beyond the last function are ignored.
+   u32 num_names = ( count > 0 ) ? ( u32 ) count : 0;
+   if ( num_names > vec_size( &loader->task->funcs ) ) {
+      num_names = vec_size( &loader->task->funcs );
+   }
+   expect_name_table( loader, &chunk, data, num_names );
+   for ( u32 i = 0; i < num_names; ++i ) {
+      u32 offset = 0;
       memcpy( &offset, data, sizeof( offset ) );
       data += sizeof( offset );
-      struct func* func = list_data( &i );
-      str_append( &func->name, ( const char* ) chunk.data + offset );
-      list_next( &i );
-      ++index;
+      struct func* func = vec_at( &loader->task->funcs, i );
+      func->name = read_chunk_name( loader, &chunk, i, offset );
+   }
+}
+
+static void expect_name_table( struct loader* loader, struct chunk* chunk,
+   const u8* data, u32 count ) {
+   if ( chunk_data_left( chunk, data ) / sizeof( u32 ) < count ) {
+      diag( loader, DIAG_ERR,
+         "%s chunk gives a number of name offsets (%u) that cannot possibly "
+         "fit in the chunk", chunk->name, count );
+      bail( loader );
    }
 }
 
+// Names are interned straight from the chunk, so a name must be terminated
+// before the end of the chunk.
+static const struct istr* read_chunk_name( struct loader* loader,
+   struct chunk* chunk, u32 index, u32 offset ) {
+   if ( ! chunk_offset_in_chunk( chunk, offset ) ) {
+      diag( loader, DIAG_ERR,
+         "string offset in position %d of %s chunk points outside of "
+         "chunk data range", index, chunk->name );
+      bail( loader );
+   }
+   const u8* name = chunk->start + offset;
+   const u8* end = memchr( name, '\0', chunk_data_left( chunk, name ) );
+   if ( ! end ) {
+      diag( loader, DIAG_ERR,
+         "string in position %d of %s chunk is not terminated", index,
+         chunk->name );
+      bail( loader );
+   }
+   return str_table_intern_sub( &loader->task->str_table,
+      ( const char* ) name, ( u32 ) ( end - name ) );
+}
+
 static void append_object( struct loader* loader, struct node* object ) {
-   struct list_iter i;
-   list_iterate( &loader->task->objects, &i );
-   while ( ! list_end( &i ) &&
-      object_offset( object ) > object_offset( list_data( &i ) ) ) {
-      list_next( &i );
+   struct vec* objects = &loader->task->objects;
+   u32 i = 0;
+   while ( i < vec_size( objects ) &&
+      object_offset( object ) > object_offset( vec_at( objects, i ) ) ) {
+      ++i;
    }
-   list_insert_before( &loader->task->objects, &i, object );
+   vec_insert( objects, i, object );
 }
 
 static u32 object_offset( struct node* node ) { 
@@ -757,24 +1000,33 @@ static u32 object_offset( struct node* node ) {
    }
 }
 
+static u32 object_end_offset( struct node* node ) {
+   if ( node->type == NODE_SCRIPT ) {
+      struct script* script = ( struct script* ) node;
+      return script->end_offset;
+   }
+   else if ( node->type == NODE_FUNC ) {
+      struct func* func = ( struct func* ) node;
+      return func->more.user->end_offset;
+   }
+   else {
+      return 0;
+   }
+}
+
 static void determine_end_of_objects( struct loader* loader ) {
 {
-   struct list_iter i;
-   list_iterate( &loader->task->objects, &i );
-   while ( ! list_end( &i ) ) {
-      //printf( "%d\n", object_offset( list_data( &i ) ) );
-      list_next( &i );
+   for ( u32 i = 0; i < vec_size( &loader->task->objects ); ++i ) {
+      //printf( "%d\n", object_offset( vec_at( &loader->task->objects, i ) ) );
    }
 }
    
-   struct list_iter i;
-   list_iterate( &loader->task->objects, &i );
-   while ( ! list_end( &i ) ) {
-      struct node* node = list_data( &i );
-      list_next( &i );
+   struct vec* objects = &loader->task->objects;
+   for ( u32 i = 0; i < vec_size( objects ); ++i ) {
+      struct node* node = vec_at( objects, i );
       u32 end_offset = loader->end_offset;
-      if ( ! list_end( &i ) ) {
-         end_offset = object_offset( list_data( &i ) );
+      if ( i + 1 < vec_size( objects ) ) {
+         end_offset = object_offset( vec_at( objects, i + 1 ) );
       }
       if ( node->type == NODE_SCRIPT ) {
          struct script* script = ( struct script* ) node;
@@ -791,30 +1043,411 @@ static void determine_end_of_objects( struct loader* loader ) {
    }
 }
 
-static void read_func_body_list( struct loader* loader ) {
-   struct list_iter i;
-   list_iterate( &loader->task->funcs, &i );
-   while ( ! list_end( &i ) ) {
-      read_func_body( loader, list_data( &i ) );
-      list_next( &i );
+// Each body must lie between the header and the end of the pcode.
+static void validate_body_ranges( struct loader* loader ) {
+   if ( loader->end_offset > loader->object_size ) {
+      diag( loader, DIAG_ERR,
+         "pcode of object file ends at offset %u, but the object file is "
+         "only %u bytes", loader->end_offset, loader->object_size );
+      bail( loader );
+   }
+   struct vec* objects = &loader->task->objects;
+   for ( u32 i = 0; i < vec_size( objects ); ++i ) {
+      struct node* node = vec_at( objects, i );
+      u32 offset = object_offset( node );
+      u32 end_offset = object_end_offset( node );
+      if ( offset >= HEADER_SIZE && offset <= end_offset &&
+         end_offset <= loader->end_offset ) {
+         continue;
+      }
+      if ( node->type == NODE_SCRIPT ) {
+         diag( loader, DIAG_ERR,
+            "script %d occupies offsets %u to %u, outside of the pcode of "
+            "the object file", ( ( struct script* ) node )->number, offset,
+            end_offset );
+      }
+      else {
+         diag( loader, DIAG_ERR,
+            "function %u occupies offsets %u to %u, outside of the pcode of "
+            "the object file", ( ( struct func* ) node )->more.user->index,
+            offset, end_offset );
+      }
+      bail( loader );
+   }
+}
+
+// When the user selects scripts or functions, only those are decompiled, along
+// with the functions they call. The rest are never decoded.
+static void apply_selection( struct loader* loader ) {
+   struct options* options = loader->task->options;
+   if ( options->num_selections == 0 ) {
+      return;
+   }
+   for ( u32 i = 0; i < vec_size( &loader->task->scripts ); ++i ) {
+      struct script* script = vec_at( &loader->task->scripts, i );
+      script->selected = false;
+   }
+   for ( u32 i = 0; i < vec_size( &loader->task->funcs ); ++i ) {
+      struct func* func = vec_at( &loader->task->funcs, i );
+      func->more.user->selected = false;
+   }
+   for ( u32 i = 0; i < options->num_selections; ++i ) {
+      if ( options->selections[ i ].func ) {
+         select_func( loader, options->selections[ i ].value );
+      }
+      else {
+         select_script( loader, options->selections[ i ].value );
+      }
+   }
+}
+
+// A script is selected by number when the value is a number, and by name
+// otherwise. Like in ACS, names are not case-sensitive.
+static void select_script( struct loader* loader, const char* value ) {
+   char* end = NULL;
+   long number = strtol( value, &end, 10 );
+   bool numbered = ( *value != '\0' && *end == '\0' );
+   bool found = false;
+   for ( u32 i = 0; i < vec_size( &loader->task->scripts ); ++i ) {
+      struct script* script = vec_at( &loader->task->scripts, i );
+      if ( script->named_script ? ( ! numbered &&
+         strcasecmp( script->name->value, value ) == 0 ) :
+         ( numbered && script->number == number ) ) {
+         script->selected = true;
+         found = true;
+      }
+   }
+   if ( ! found ) {
+      diag( loader, DIAG_ERR,
+         "selected script (%s) not found in object file", value );
+      bail( loader );
    }
 }
 
-static void read_func_body( struct loader* loader, struct func* func ) {
-   const u8* data = loader->object_data + func->more.user->offset;
-   const u8* data_end = loader->object_data + func->more.user->end_offset;
+static void select_func( struct loader* loader, const char* value ) {
+   bool found = false;
+   for ( u32 i = 0; i < vec_size( &loader->task->funcs ); ++i ) {
+      struct func* func = vec_at( &loader->task->funcs, i );
+      if ( func->name && strcasecmp( func->name->value, value ) == 0 ) {
+         func->more.user->selected = true;
+         found = true;
+      }
+   }
+   if ( ! found ) {
+      diag( loader, DIAG_ERR,
+         "selected function (%s) not found in object file", value );
+      bail( loader );
+   }
+}
+
+// The functions called by the selected bodies are only known once those
+// bodies are decoded, so the functions are decoded in rounds, until no more
+// new functions are called.
+static void read_body_list( struct loader* loader ) {
+   struct task* task = loader->task;
+   struct mem_arena* arena = mem_select_arena( &task->load_region );
+   struct body_job* jobs = mem_alloc( sizeof( jobs[ 0 ] ) *
+      ( vec_size( &task->scripts ) + vec_size( &task->funcs ) ) );
+   u32 num_jobs = 0;
+   for ( u32 i = 0; i < vec_size( &task->scripts ); ++i ) {
+      struct script* script = vec_at( &task->scripts, i );
+      if ( script->selected ) {
+         add_body_job( loader, &jobs[ num_jobs ], script->offset,
+            script->end_offset, &script->body_start, &script->body_end,
+            &script->jumps );
+         ++num_jobs;
+      }
+   }
+   for ( u32 i = 0; i < vec_size( &task->funcs ); ++i ) {
+      struct func* func = vec_at( &task->funcs, i );
+      if ( func->more.user->selected ) {
+         add_func_job( loader, &jobs[ num_jobs ], func );
+         ++num_jobs;
+      }
+   }
+   decode_bodies( loader, jobs, num_jobs );
+   if ( task->options->num_selections > 0 ) {
+      struct body_job* called_jobs = mem_alloc( sizeof( called_jobs[ 0 ] ) *
+         vec_size( &task->funcs ) );
+      while ( num_jobs > 0 ) {
+         num_jobs = add_called_funcs( loader, jobs, num_jobs, called_jobs );
+         decode_bodies( loader, called_jobs, num_jobs );
+         struct body_job* decoded_jobs = jobs;
+         jobs = called_jobs;
+         called_jobs = decoded_jobs;
+      }
+   }
+   mem_select_arena( arena );
+}
+
+// Selects the functions called by the decoded bodies that are not selected
+// already. Returns the number of newly selected functions.
+static u32 add_called_funcs( struct loader* loader, struct body_job* jobs,
+   u32 num_jobs, struct body_job* called_jobs ) {
+   u32 num_called = 0;
+   for ( u32 i = 0; i < num_jobs; ++i ) {
+      struct pcode* pcode = *jobs[ i ].start;
+      while ( pcode != PCODE_NEXT( *jobs[ i ].end ) ) {
+         switch ( pcode->opcode ) {
+         case PCD_CALL:
+         case PCD_CALLDISCARD:
+         case PCD_PUSHFUNCTION: {
+               struct generic_pcode* generic = ( struct generic_pcode* ) pcode;
+               struct func* func = t_find_func( loader->task,
+                  ( u32 ) generic->args[ 0 ] );
+               if ( func && ! func->more.user->selected ) {
+                  func->more.user->selected = true;
+                  add_func_job( loader, &called_jobs[ num_called ], func );
+                  ++num_called;
+               }
+            }
+            break;
+         default:
+            break;
+         }
+         pcode = PCODE_NEXT( pcode );
+      }
+   }
+   return num_called;
+}
+
+static void add_func_job( struct loader* loader, struct body_job* job,
+   struct func* func ) {
+   add_body_job( loader, job, func->more.user->offset,
+      func->more.user->end_offset, &func->more.user->start,
+      &func->more.user->end, &func->more.user->jumps );
+}
+
+// Every body can be decoded independently of the others, so when there is
+// enough pcode, the bodies are decoded by several threads at once. Each thread
+// allocates from its own region.
+static void decode_bodies( struct loader* loader, struct body_job* jobs,
+   u32 num_jobs ) {
+   u64 size = 0;
+   for ( u32 i = 0; i < num_jobs; ++i ) {
+      size += ( u64 ) ( jobs[ i ].data_end - jobs[ i ].data );
+   }
+   u32 num_workers = count_decode_workers( loader, num_jobs, size );
+   struct decode_worker* workers = mem_alloc( sizeof( workers[ 0 ] ) *
+      num_workers );
+   for ( u32 i = 0; i < num_workers; ++i ) {
+      init_decode_worker( loader, &workers[ i ], jobs, num_jobs, i,
+         num_workers );
+   }
+   // The calling thread does the work of the first worker. A worker whose
+   // thread cannot be started is run by the calling thread instead.
+   bool started[ MAX_DECODE_WORKERS ] = { false };
+   for ( u32 i = 1; i < num_workers; ++i ) {
+      started[ i ] = thread_start( &workers[ i ].thread, run_decode_worker,
+         &workers[ i ] );
+   }
+   run_decode_worker( &workers[ 0 ] );
+   for ( u32 i = 1; i < num_workers; ++i ) {
+      if ( started[ i ] ) {
+         thread_join( &workers[ i ].thread );
+      }
+      else {
+         run_decode_worker( &workers[ i ] );
+      }
+   }
+   report_decode_error( loader, workers, num_workers );
+}
+
+static void add_body_job( struct loader* loader, struct body_job* job,
+   u32 offset, u32 end_offset, struct pcode** start, struct pcode** end,
+   struct jump_index* jumps ) {
+   job->data = loader->object_data + offset;
+   job->data_end = loader->object_data + end_offset;
+   job->start = start;
+   job->end = end;
+   // The jumps are only indexed for the Annotation stage.
+   job->jumps = loader->task->options->disassemble ? NULL : jumps;
+}
+
+// Allocation statistics are gathered by counters shared between arenas, so
+// when statistics are wanted, the bodies are decoded by a single thread.
+static u32 count_decode_workers( struct loader* loader, u32 num_jobs,
+   u64 size ) {
+   if ( loader->task->options->mem_stats || size < MIN_PARALLEL_DECODE_SIZE ) {
+      return 1;
+   }
+   u32 count = thread_count_cpus();
+   if ( count > MAX_DECODE_WORKERS ) {
+      count = MAX_DECODE_WORKERS;
+   }
+   if ( count > num_jobs ) {
+      count = num_jobs;
+   }
+   return ( count > 0 ) ? count : 1;
+}
+
+static void init_decode_worker( struct loader* loader,
+   struct decode_worker* worker, struct body_job* jobs, u32 num_jobs,
+   u32 index, u32 num_workers ) {
+   worker->loader = loader;
+   worker->jobs = jobs;
+   worker->num_jobs = num_jobs;
+   worker->job = index;
+   worker->job_step = num_workers;
+   init_pcode_buffer( &worker->buffer );
+   // The first worker allocates from the load region itself.
+   if ( index == 0 ) {
+      worker->region = &loader->task->load_region;
+   }
+   else {
+      struct mem_arena* arena = mem_select_arena( &loader->task->arena );
+      worker->region = mem_alloc( sizeof( *worker->region ) );
+      mem_arena_init( worker->region );
+      vec_append( &loader->task->decode_regions, worker->region );
+      mem_select_arena( arena );
+   }
+   str_init( &worker->error );
+   worker->error_flags = 0;
+   worker->failed = false;
+}
+
+// A worker stops at the first body it fails to decode.
+static void run_decode_worker( void* data ) {
+   struct decode_worker* worker = data;
+   struct mem_arena* arena = mem_select_arena( worker->region );
+   if ( setjmp( worker->bail ) == 0 ) {
+      while ( worker->job < worker->num_jobs ) {
+         read_body( worker, &worker->jobs[ worker->job ] );
+         worker->job += worker->job_step;
+      }
+   }
+   else {
+      worker->failed = true;
+   }
+   mem_select_arena( arena );
+}
+
+// A body is validated before it is decoded, so the decoding itself does not
+// need to check anything it reads.
+static void read_body( struct decode_worker* worker, struct body_job* job ) {
    struct pcode_reading reading;
-   init_pcode_reading( &reading, data, data_end );
-   read_pcode_list( loader, &reading );
-   func->more.user->start = reading.head;
-   func->more.user->end = reading.tail->prev;
-/*
-   struct pcode* pcode = script->body_start;
-   while ( pcode != script->body_end->next ) {
-      printf( "%d\n", pcode->opcode );
-      pcode = pcode->next;
+   init_pcode_reading( &reading, worker, job->data, job->data_end );
+   struct body_layout layout;
+   validate_body( worker->loader, &reading, &layout );
+   reserve_pcode_buffer( &worker->buffer, &layout );
+   read_pcode_list( worker->loader, &reading );
+   if ( job->jumps ) {
+      index_jumps( &reading, job->jumps );
+   }
+   *job->start = reading.start;
+   *job->end = reading.end;
+}
+
+// Makes sure that every instruction of the body is known and lies completely
+// inside the body.
+static void validate_body( struct loader* loader,
+   struct pcode_reading* reading, struct body_layout* layout ) {
+   layout->num_pcode = 0;
+   layout->num_args = 0;
+   layout->num_cases = 0;
+   const u8* data = reading->data;
+   while ( data < reading->data_end ) {
+      u64 left = ( u64 ) ( reading->data_end - data );
+      u64 size = validate_pcode( loader, reading, data, left, layout );
+      if ( size > left ) {
+         decode_error( reading, DIAG_ERR,
+            "pcode at position %u goes past the end of the script or "
+            "function it belongs to", ( u32 ) ( data - loader->object_data ) );
+      }
+      ++layout->num_pcode;
+      data += size;
+   }
+}
+
+// Returns the size of the instruction. The size is larger than what is left of
+// the body when the instruction is cut off.
+static u64 validate_pcode( struct loader* loader,
+   struct pcode_reading* reading, const u8* data, u64 left,
+   struct body_layout* layout ) {
+   u32 obj_pos = ( u32 ) ( data - loader->object_data );
+   u64 size = opcode_size( loader, data );
+   if ( size > left ) {
+      return size;
+   }
+   i32 opcode = PCD_NOP;
+   decode_opcode( loader, data, &opcode );
+   switch ( opcode ) {
+   case PCD_GOTO:
+   case PCD_IFGOTO:
+   case PCD_IFNOTGOTO:
+      return size + sizeof( i32 );
+   case PCD_CASEGOTO:
+      return size + sizeof( i32 ) * 2;
+   case PCD_CASEGOTOSORTED: {
+         // The case table is aligned to a 4-byte boundary.
+         size = ( ( obj_pos + size + 3 ) & ~( u64 ) 0x3 ) - obj_pos;
+         i32 count = 0;
+         if ( size + sizeof( count ) > left ) {
+            return size + sizeof( count );
+         }
+         memcpy( &count, data + size, sizeof( count ) );
+         if ( count < 0 ) {
+            decode_error( reading, DIAG_ERR,
+               "pcode at position %u has a negative number of cases (%d)",
+               obj_pos, count );
+         }
+         layout->num_cases += ( u32 ) count;
+         return size + sizeof( count ) + ( u64 ) count * sizeof( i32 ) * 2;
+      }
+   case PCD_PUSHBYTES:
+      if ( size >= left ) {
+         return size + 1;
+      }
+      layout->num_args += 1u + data[ size ];
+      return size + 1 + data[ size ];
+   default:
+      break;
+   }
+   if ( opcode < 0 || opcode >= PCD_TOTAL ) {
+      decode_error( reading, DIAG_ERR,
+         "encountered unknown pcode (opcode: %d) at position %u",
+         opcode, obj_pos );
+   }
+   const struct operand_layout* operands =
+      &loader->operand_layouts[ opcode ];
+   if ( ! operands->supported ) {
+      decode_error( reading, DIAG_INTERNAL | DIAG_ERR,
+         "unhandled pcode (%d) at: %s:%d", opcode, __FILE__,
+         __LINE__ );
    }
-*/
+   layout->num_args += ( u32 ) operands->argc;
+   return size + ( u64 ) operands->size;
+}
+
+// When several bodies fail to decode, the error of the body that comes first is
+// reported, no matter which worker finished first.
+static void report_decode_error( struct loader* loader,
+   struct decode_worker* workers, u32 num_workers ) {
+   struct decode_worker* failed_worker = NULL;
+   for ( u32 i = 0; i < num_workers; ++i ) {
+      if ( workers[ i ].failed && ( ! failed_worker ||
+         workers[ i ].job < failed_worker->job ) ) {
+         failed_worker = &workers[ i ];
+      }
+   }
+   if ( failed_worker ) {
+      t_diag( loader->task, failed_worker->error_flags, "%s",
+         failed_worker->error.value );
+      bail( loader );
+   }
+}
+
+// Errors found while decoding are recorded by the worker and reported by the
+// thread that started decoding.
+static void decode_error( struct pcode_reading* reading, i32 flags,
+   const char* format, ... ) {
+   struct decode_worker* worker = reading->worker;
+   va_list args;
+   va_start( args, format );
+   str_append_format( &worker->error, format, &args );
+   va_end( args );
+   worker->error_flags = flags;
+   longjmp( worker->bail, 1 );
 }
 
 static u32 chunk_data_left( struct chunk* chunk, const u8* data ) {
@@ -862,37 +1495,11 @@ static void read_strings( struct loader* loader ) {
       bail( loader );
    }
    reserve_strings( loader, count );
-   for ( u32 i = 0; i < count; ++i ) {
-      u32 offset = 0;
-      memcpy( &offset, data, sizeof( offset ) );
-      data += sizeof( offset );
-      if ( ! chunk_offset_in_chunk( &chunk, offset ) ) {
-         diag( loader, DIAG_ERR,
-            "string offset in position %d of %s chunk points outside of "
-            "chunk data range", i, chunk.name );
-         bail( loader );
-      }
-      const u8* start = chunk.start + offset;
-      const u8* string_data = start;
-      while ( chunk_data_left( &chunk, string_data ) ) {
-         u8 ch = *string_data;
-         if ( loader->task->encrypt_str ) {
-            ch = decrypt_ch( offset, ( u32 ) ( string_data - start ), ch );
-         }
-         char string_part[] = { ( char ) ch, '\0' };
-         str_append( &loader->task->strings[ i ], string_part );
-         if ( ! ch ) {
-            break;
-         }
-         ++string_data;
-      }
-      if ( ! chunk_data_left( &chunk, string_data ) ) {
-         diag( loader, DIAG_ERR,
-            "unterminated string at offset %d of %s chunk", offset,
-            chunk.name );
-         bail( loader );
-      }
-   }
+   loader->task->string_source.data = chunk.start;
+   loader->task->string_source.offsets = data;
+   loader->task->string_source.size = chunk.size;
+   loader->task->string_source.name = loader->task->encrypt_str ?
+      "STRE chunk" : "STRL chunk";
 }
 
 static void reserve_strings( struct loader* loader, u32 num_strings ) {
@@ -900,15 +1507,111 @@ static void reserve_strings( struct loader* loader, u32 num_strings ) {
    loader->task->strings = mem_alloc(
       sizeof( loader->task->strings[ 0 ] ) * num_strings );
    for ( u32 i = 0; i < num_strings; ++i ) {
-      str_init( &loader->task->strings[ i ] );
+      loader->task->strings[ i ] = NULL;
    }
 }
 
-static u8 decrypt_ch( u32 string_offset, u32 ch_pos, u8 ch ) {
+// Strings are decoded the first time they are looked up, so a string that is
+// never referenced costs only its slot in task->strings.
+const char* t_lookup_string( struct task* task, u32 index ) {
+   const char* string = t_find_string( task, index );
+   if ( ! string && index < task->num_strings ) {
+      u32 offset = read_string_offset( task, index );
+      if ( offset >= task->string_source.size ) {
+         t_diag( task, DIAG_ERR,
+            "string offset in position %d of %s points outside of "
+            "data range", index, task->string_source.name );
+      }
+      else {
+         t_diag( task, DIAG_ERR,
+            "unterminated string at offset %d of %s", offset,
+            task->string_source.name );
+      }
+      t_bail( task );
+   }
+   return string;
+}
+
+/**
+ * Like t_lookup_string(), but a string that cannot be decoded is reported as
+ * missing instead of being an error.
+ */
+const char* t_find_string( struct task* task, u32 index ) {
+   if ( index >= task->num_strings ) {
+      return NULL;
+   }
+   if ( ! task->strings[ index ] ) {
+      u32 offset = read_string_offset( task, index );
+      if ( offset >= task->string_source.size ) {
+         return NULL;
+      }
+      struct str buffer;
+      str_init( &buffer );
+      task->strings[ index ] = decode_string( task, task->string_source.data,
+         task->string_source.size, offset, task->encrypt_str, &buffer );
+      str_deinit( &buffer );
+      if ( ! task->strings[ index ] ) {
+         return NULL;
+      }
+   }
+   return task->strings[ index ]->value;
+}
+
+static u32 read_string_offset( struct task* task, u32 index ) {
+   u32 offset = 0;
+   memcpy( &offset, task->string_source.offsets + sizeof( offset ) * index,
+      sizeof( offset ) );
+   return offset;
+}
+
+// Decodes the string found at the specified offset of the data. A plain string
+// is interned straight from the data. An encrypted string is decrypted into the
+// buffer a block at a time, and each block is searched for the terminator.
+// Returns NULL if the string is not terminated before the end of the data.
+static const struct istr* decode_string( struct task* task, const u8* data,
+   u32 size, u32 offset, bool encrypted, struct str* buffer ) {
+   enum { BLOCK_SIZE = 64 };
+   const u8* start = data + offset;
+   u32 left = size - offset;
+   if ( ! encrypted ) {
+      const u8* end = memchr( start, '\0', left );
+      if ( ! end ) {
+         return NULL;
+      }
+      return str_table_intern_sub( &task->str_table, ( const char* ) start,
+         ( u32 ) ( end - start ) );
+   }
+   u32 length = 0;
+   while ( length < left ) {
+      u32 count = left - length;
+      if ( count > BLOCK_SIZE ) {
+         count = BLOCK_SIZE;
+      }
+      if ( ( u32 ) buffer->buffer_length < length + count ) {
+         str_grow( buffer, ( i32 ) ( ( length + count ) * 2 ) );
+      }
+      u8* output = ( u8* ) buffer->value + length;
+      decrypt_block( output, start + length, offset, length, count );
+      const u8* end = memchr( output, '\0', count );
+      if ( end ) {
+         return str_table_intern_sub( &task->str_table, buffer->value,
+            length + ( u32 ) ( end - output ) );
+      }
+      length += count;
+   }
+   return NULL;
+}
+
+// The key of an encrypted character depends only on the offset of the string
+// and the position of the character, so the characters can be decrypted
+// independently of each other.
+static void decrypt_block( u8* output, const u8* input, u32 string_offset,
+   u32 pos, u32 count ) {
    enum { ENCRYPTION_CONSTANT = 157135 };
-   ch = ( u8 ) (
-      ch ^ ( ( ENCRYPTION_CONSTANT * string_offset ) + ch_pos / 2 ) );
-   return ch;
+   u32 key = ENCRYPTION_CONSTANT * string_offset;
+   for ( u32 i = 0; i < count; ++i ) {
+      output[ i ] = ( u8 ) ( input[ i ] ^ ( key + ( pos + i ) / 2 ) );
+   }
 }
 
 static void expect_chunk_data( struct loader* loader, struct chunk* chunk,
@@ -986,16 +1689,12 @@ static void read_aray( struct loader* loader ) {
 }
 
 static void read_aini( struct loader* loader ) {
-   const u8* offset = NULL;
-   while ( true ) {
-      struct chunk chunk;
-      init_chunk( &chunk, "AINI" );
-      find_chunk_from_offset( loader, &chunk, offset );
-      if ( ! chunk.found ) {
-         return;
-      }
+   struct chunk chunk;
+   init_chunk( &chunk, "AINI" );
+   find_chunk( loader, &chunk );
+   while ( chunk.found ) {
       read_aini_chunk( loader, &chunk );
-      offset = chunk.data + chunk.size;
+      next_chunk( loader, &chunk );
    }
 }
 
@@ -1192,14 +1891,16 @@ static void read_mexp( struct loader* loader ) {
    }
    const u8* data = chunk.data;
    u32 count = 0;
+   expect_chunk_data( loader, &chunk, data, sizeof( count ) );
    memcpy( &count, data, sizeof( count ) );
    data += sizeof( count );
+   expect_name_table( loader, &chunk, data, count );
    for ( u32 i = 0; i < count; ++i ) {
       u32 offset = 0;
       memcpy( &offset, data, sizeof( offset ) );
       struct var* var = t_reserve_map_var( loader->task, i );
       if ( offset ) {
-         str_append( &var->name, ( const char* ) ( chunk.data + offset ) );
+         var->name = read_chunk_name( loader, &chunk, i, offset );
       }
       data += sizeof( offset );
    }
@@ -1207,7 +1908,17 @@ static void read_mexp( struct loader* loader ) {
    determine_library_name( loader );
 }
 
+// The library of a WAD lump is named after the lump. Lump names are usually in
+// uppercase, while library names are usually in lowercase.
 static void determine_library_name( struct loader* loader ) {
+   const char* lump_name = loader->task->input.lump_name;
+   if ( lump_name ) {
+      for ( const char* ch = lump_name; *ch; ++ch ) {
+         char lowercase_ch = ( char ) tolower( ( u8 ) *ch );
+         str_append_sub( &loader->task->library_name, &lowercase_ch, 1 );
+      }
+      return;
+   }
    const char* filename = strrchr( loader->task->options->object_file,
       OS_PATHSEP[ 0 ] );
    if ( filename ) {
@@ -1229,9 +1940,8 @@ static void read_load( struct loader* loader ) {
    while ( i < chunk.size ) {
       if ( chunk.data[ i ] == '\0' ) {
          struct imported_module* module = mem_alloc( sizeof( *module ) );
-         str_init( &module->name );
-         str_append_sub( &module->name,
-            ( const char* ) ( chunk.data + start ), ( i32 ) ( i - start ) );
+         module->name = str_table_intern_sub( &loader->task->str_table,
+            ( const char* ) ( chunk.data + start ), i - start );
          list_append( &loader->task->imports, module );
          start = i + 1;
       }
@@ -1260,8 +1970,8 @@ static void read_mimp( struct loader* loader ) {
       if ( i >= chunk.size ) {}
       struct var* var = t_reserve_map_var( loader->task, index );
       if ( var ) {}
-      str_append_sub( &var->name, ( const char * )
-         ( chunk.data + start ), ( i32 ) ( i - start ) );
+      var->name = str_table_intern_sub( &loader->task->str_table,
+         ( const char* ) ( chunk.data + start ), i - start );
       var->imported = true;
       ++i;
    }
@@ -1291,8 +2001,8 @@ static void read_aimp( struct loader* loader ) {
       if ( i >= chunk.size ) {}
       struct var* var = t_reserve_map_var( loader->task, index );
       if ( var ) {}
-      str_append_sub( &var->name, ( const char * )
-         ( chunk.data + start ), ( i32 ) ( i - start ) );
+      var->name = str_table_intern_sub( &loader->task->str_table,
+         ( const char* ) ( chunk.data + start ), i - start );
       var->dim_length = size;
       var->array = true;
       var->imported = true;
@@ -1343,27 +2053,23 @@ static void read_astr( struct loader* loader ) {
 static void read_zero_object( struct loader* loader ) {
    read_script_list( loader );
    read_string_table( loader );
+   apply_selection( loader );
    determine_end_of_objects( loader );
-   read_script_body_list( loader );
+   validate_body_ranges( loader );
+   read_body_list( loader );
 }
 
 // TODO: Read all the scripts before reading their pcodes, so the end of each
 // script can be determined.
 static void read_script_list( struct loader* loader ) {
-   const u8* data = loader->object_data + loader->directory_offset;
-   i32 num_scripts = 0;
-   memcpy( &num_scripts, data, sizeof( num_scripts ) );
-   data += sizeof( num_scripts );
-   i32 i = 0;
-   while ( i < num_scripts ) {
-      struct {
-         u32 number;
-         u32 offset;
-         u32 num_param;
-      } entry;
+   const u8* data = loader->object_data + loader->directory_offset +
+      sizeof( i32 );
+   u32 i = 0;
+   while ( i < loader->num_directory_entries ) {
+      struct directory_entry entry;
       memcpy( &entry, data, sizeof( entry ) );
       data += sizeof( entry );
-      struct script* script = mem_alloc( sizeof( *script ) );
+      struct script* script = alloc_script();
       script->number = ( i32 ) ( entry.number % 1000 );
       script->type = entry.number / 1000;
       script->num_param = entry.num_param;
@@ -1376,7 +2082,8 @@ static void read_script_list( struct loader* loader ) {
          script->vars[ i ] = NULL;
       }
       // read_script_pcode( load, script );
-      list_append( &loader->task->scripts, script );
+      vec_append( &loader->task->scripts, script );
+      append_object( loader, &script->node );
       ++i;
    }
    loader->string_offset = ( u32 ) ( data - loader->object_data );
@@ -1390,13 +2097,23 @@ static void read_script( struct loader* loader ) {
 static void read_string_table( struct loader* loader ) {
    const u8* data = loader->object_data + loader->string_offset;
    u32 num_strings = 0;
+   expect_data( loader, data, sizeof( num_strings ) );
    memcpy( &num_strings, data, sizeof( num_strings ) );
    data += sizeof( num_strings );
+   if ( data_left( loader, data ) / sizeof( u32 ) < num_strings ) {
+      diag( loader, DIAG_ERR,
+         "string table gives %u string offsets but the object file is too "
+         "small to contain that many offsets", num_strings );
+      bail( loader );
+   }
    reserve_strings( loader, num_strings );
+   loader->task->string_source.data = loader->object_data;
+   loader->task->string_source.offsets = data;
+   loader->task->string_source.size = loader->object_size;
+   loader->task->string_source.name = "string table";
    for ( u32 i = 0; i < num_strings; ++i ) {
       u32 offset = 0;
       memcpy( &offset, data, sizeof( offset ) );
-      str_append( &loader->task->strings[ i ], ( const char* ) loader->object_data + offset );
       data += sizeof( offset );
       if ( i == 0 ) {
          loader->end_offset = offset;
@@ -1404,63 +2121,127 @@ static void read_string_table( struct loader* loader ) {
    }
 }
 
-static void read_script_body_list( struct loader* loader ) {
-   struct list_iter i;
-   list_iterate( &loader->task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      read_script_body( loader, list_data( &i ) );
-      list_next( &i );
-   }
-}
-
-static void read_script_body( struct loader* loader, struct script* script ) {
-   const u8* data = loader->object_data + script->offset;
-   const u8* data_end = loader->object_data + script->end_offset;
-   struct pcode_reading reading;
-   init_pcode_reading( &reading, data, data_end );
-   read_pcode_list( loader, &reading );
-   script->body_start = reading.head;
-   script->body_end = reading.tail->prev;
-/*
-   struct pcode* pcode = script->body_start;
-   while ( pcode != script->body_end->next ) {
-      printf( "%d\n", pcode->opcode );
-      pcode = pcode->next;
-   }
-*/
-}
-
-static void init_pcode_reading( struct pcode_reading* reading, const u8* data,
-   const u8* data_end ) {
+static void init_pcode_reading( struct pcode_reading* reading,
+   struct decode_worker* worker, const u8* data, const u8* data_end ) {
+   struct pcode_buffer* buffer = &worker->buffer;
+   reading->worker = worker;
    reading->data = data;
    reading->data_end = data_end;
-   reading->head = NULL;
-   reading->tail = NULL;
+   reading->buffer = buffer;
+   reading->start = NULL;
+   reading->end = NULL;
+   reading->start_obj_pos = 0;
+   reading->end_obj_pos = 0;
    reading->opcode = PCD_NOP;
    reading->obj_pos = 0;
-}
-
-static void append_pcode( struct pcode_reading* reading,
-   struct pcode* pcode ) {
-   if ( reading->head ) {
-      pcode->prev = reading->tail;
-      reading->tail->next = pcode;
-   }
-   else {
-      reading->head = pcode;
-   }
-   reading->tail = pcode;
-}
-
+   buffer->num_slots = 0;
+   buffer->num_args = 0;
+   buffer->num_cases = 0;
+}
+
+static void init_pcode_buffer( struct pcode_buffer* buffer ) {
+   buffer->slots = NULL;
+   buffer->args = NULL;
+   buffer->cases = NULL;
+   buffer->num_slots = 0;
+   buffer->slots_capacity = 0;
+   buffer->num_args = 0;
+   buffer->args_capacity = 0;
+   buffer->num_cases = 0;
+   buffer->cases_capacity = 0;
+   buffer->targets = NULL;
+   buffer->targets_capacity = 0;
+}
+
+// Makes room for the whole body, sentinels included, so appending to the buffer
+// never needs to grow it.
+static void reserve_pcode_buffer( struct pcode_buffer* buffer,
+   struct body_layout* layout ) {
+   buffer->slots = reserve_buffer( buffer->slots, &buffer->slots_capacity,
+      layout->num_pcode + 2, sizeof( buffer->slots[ 0 ] ) );
+   buffer->args = reserve_buffer( buffer->args, &buffer->args_capacity,
+      layout->num_args, sizeof( buffer->args[ 0 ] ) );
+   buffer->cases = reserve_buffer( buffer->cases, &buffer->cases_capacity,
+      layout->num_cases, sizeof( buffer->cases[ 0 ] ) );
+}
+
+static union pcode_slot* append_pcode( struct pcode_reading* reading,
+   i32 opcode ) {
+   struct pcode_buffer* buffer = reading->buffer;
+   union pcode_slot* slot = &buffer->slots[ buffer->num_slots ];
+   ++buffer->num_slots;
+   init_pcode( &slot->pcode, opcode );
+   slot->pcode.obj_pos = ( i32 ) reading->obj_pos;
+   return slot;
+}
+
+static void* reserve_buffer( void* items, u32* capacity, u32 count,
+   size_t item_size ) {
+   if ( count <= *capacity ) {
+      return items;
+   }
+   *capacity = ( *capacity == 0 ) ? 64 : *capacity * 2;
+   if ( *capacity < count ) {
+      *capacity = count;
+   }
+   return mem_realloc( items, item_size * *capacity );
+}
+
+// The body is surrounded by two sentinels, so every pcode of the body has a
+// neighbor on both sides. The trailing sentinel takes the position right after
+// the body, where a jump to the end of the body lands.
 static void read_pcode_list( struct loader* loader,
    struct pcode_reading* reading ) {
+   reading->start_obj_pos = ( u32 ) ( reading->data - loader->object_data );
+   reading->end_obj_pos = ( u32 ) ( reading->data_end - loader->object_data );
+   struct generic_pcode* sentinel = append_generic_pcode( reading, PCD_NOP );
+   sentinel->pcode.obj_pos = -1;
    while ( have_pcode( reading ) ) {
       read_pcode( loader, reading );
    }
-   struct pcode* pcode = mem_alloc( sizeof( *pcode ) );
-   init_pcode( pcode, PCD_TERMINATE );
-   pcode->obj_pos = 100000;
-   append_pcode( reading, pcode );
+   sentinel = append_generic_pcode( reading, PCD_TERMINATE );
+   sentinel->pcode.obj_pos = ( i32 ) reading->end_obj_pos;
+   copy_pcode_list( reading );
+   map_targets( reading );
+   patch_body( reading );
+}
+
+static void copy_pcode_list( struct pcode_reading* reading ) {
+   struct pcode_buffer* buffer = reading->buffer;
+   union pcode_slot* slots = copy_buffer( buffer->slots,
+      sizeof( slots[ 0 ] ) * buffer->num_slots );
+   i32* args = copy_buffer( buffer->args,
+      sizeof( args[ 0 ] ) * buffer->num_args );
+   struct casejump_pcode* cases = copy_buffer( buffer->cases,
+      sizeof( cases[ 0 ] ) * buffer->num_cases );
+   // Arguments and cases are stored in the same order as the pcode they
+   // belong to.
+   for ( u32 i = 0; i < buffer->num_slots; ++i ) {
+      switch ( slots[ i ].pcode.opcode ) {
+      case PCD_GOTO:
+      case PCD_IFGOTO:
+      case PCD_IFNOTGOTO:
+      case PCD_CASEGOTO:
+         break;
+      case PCD_CASEGOTOSORTED:
+         slots[ i ].sortedcasejump.cases = cases;
+         cases += slots[ i ].sortedcasejump.count;
+         break;
+      default:
+         slots[ i ].generic.args = args;
+         args += slots[ i ].generic.num_args;
+      }
+   }
+   reading->start = &slots[ 1 ].pcode;
+   reading->end = &slots[ buffer->num_slots - 2 ].pcode;
+}
+
+static void* copy_buffer( const void* items, size_t size ) {
+   void* copy = mem_alloc( size );
+   if ( size > 0 ) {
+      memcpy( copy, items, size );
+   }
+   return copy;
 }
 
 static bool have_pcode( struct pcode_reading* reading ) {
@@ -1489,28 +2270,34 @@ static void read_pcode( struct loader* loader, struct pcode_reading* reading ) {
    default:
       read_generic( loader, reading );
    }
-   reading->tail->obj_pos = ( i32 ) obj_pos;
 }
 
 static void read_opcode( struct loader* loader,
    struct pcode_reading* reading ) {
-   i32 opcode = PCD_NOP;
+   reading->data += decode_opcode( loader, reading->data, &reading->opcode );
+}
+
+// In the compact encoding, an opcode below 240 takes a single byte, and the
+// other opcodes take two bytes.
+static u32 opcode_size( struct loader* loader, const u8* data ) {
    if ( loader->small_code ) {
-      u8 ch = 0;
-      memcpy( &ch, reading->data, sizeof( ch ) );
-      reading->data += sizeof( ch );
-      opcode = ch;
-      if ( opcode >= 240 ) {
-         memcpy( &ch, reading->data, sizeof( ch ) );
-         reading->data += sizeof( ch );
-         opcode += ch;
-      }
+      return ( data[ 0 ] >= 240 ) ? 2 : 1;
    }
-   else {
-      memcpy( &opcode, reading->data, sizeof( opcode ) );
-      reading->data += sizeof( opcode );
+   return sizeof( i32 );
+}
+
+static u32 decode_opcode( struct loader* loader, const u8* data,
+   i32* opcode ) {
+   if ( loader->small_code ) {
+      *opcode = data[ 0 ];
+      if ( *opcode >= 240 ) {
+         *opcode += data[ 1 ];
+         return 2;
+      }
+      return 1;
    }
-   reading->opcode = opcode;
+   memcpy( opcode, data, sizeof( *opcode ) );
+   return sizeof( *opcode );
 }
 
 static i32 read_uint8( struct pcode_reading* reading ) {
@@ -1572,108 +2359,137 @@ static void read_arg( struct pcode_reading* reading, i32* value ) {
 }
 
 static void read_jump( struct pcode_reading* reading ) {
-   struct jump_pcode* jump = mem_alloc( sizeof( *jump ) );
-   init_pcode( &jump->pcode, reading->opcode );
+   struct jump_pcode* jump = &append_pcode( reading, reading->opcode )->jump;
+   jump->destination = NULL;
+   jump->destination_obj_pos = 0;
    read_arg( reading, &jump->destination_obj_pos );
-   append_pcode( reading, &jump->pcode );
 }
 
 static void read_casejump( struct pcode_reading* reading ) {
-   struct casejump_pcode* jump = mem_alloc( sizeof( *jump ) );
-   init_pcode( &jump->pcode, PCD_CASEGOTO );
-   jump->next = NULL;
+   struct casejump_pcode* jump = &append_pcode( reading,
+      PCD_CASEGOTO )->casejump;
    jump->destination = NULL;
    jump->destination_obj_pos = 0;
    jump->value = 0;
    read_arg( reading, &jump->value );
    read_arg( reading, &jump->destination_obj_pos );
-   append_pcode( reading, &jump->pcode );
 }
 
 static void read_sortedcasejump( struct loader* loader,
    struct pcode_reading* reading ) {
-   struct sortedcasejump_pcode* jump = mem_alloc( sizeof( *jump ) );
-   init_pcode( &jump->pcode, PCD_CASEGOTOSORTED );
-   jump->head = NULL;
-   jump->tail = NULL;
+   struct sortedcasejump_pcode* jump = &append_pcode( reading,
+      PCD_CASEGOTOSORTED )->sortedcasejump;
+   jump->cases = NULL;
    jump->count = 0;
    reading->data = loader->object_data +
       ( ( reading->data - loader->object_data + 3 ) & ~0x3 );
    i32 count = read_int32( reading );
    for ( i32 i = 0; i < count; ++i ) {
-      struct casejump_pcode* case_jump = mem_alloc( sizeof( *case_jump ) );
-      init_pcode( &case_jump->pcode, PCD_CASEGOTO );
-      case_jump->pcode.obj_pos = ( i32 ) reading->obj_pos;
-      case_jump->next = NULL;
-      case_jump->destination = NULL;
-      case_jump->destination_obj_pos = 0;
-      case_jump->value = 0;
+      struct casejump_pcode* case_jump = append_case( reading, jump );
       case_jump->value = read_int32( reading );
       case_jump->destination_obj_pos = read_int32( reading );
-      append_casejump( jump, case_jump );
    }
-   append_pcode( reading, &jump->pcode );
 }
 
-static void append_casejump( struct sortedcasejump_pcode* jump,
-   struct casejump_pcode* case_jump ) {
-   if ( jump->head ) {
-      jump->tail->next = case_jump;
-   }
-   else {
-      jump->head = case_jump;
-   }
-   jump->tail = case_jump;
+static struct casejump_pcode* append_case( struct pcode_reading* reading,
+   struct sortedcasejump_pcode* jump ) {
+   struct pcode_buffer* buffer = reading->buffer;
+   struct casejump_pcode* case_jump = &buffer->cases[ buffer->num_cases ];
+   ++buffer->num_cases;
+   init_pcode( &case_jump->pcode, PCD_CASEGOTO );
+   case_jump->pcode.obj_pos = ( i32 ) reading->obj_pos;
+   case_jump->destination = NULL;
+   case_jump->destination_obj_pos = 0;
+   case_jump->value = 0;
    ++jump->count;
+   return case_jump;
 }
 
 static void read_pushbytes( struct loader* loader,
    struct pcode_reading* reading ) {
-   struct generic_pcode* generic = alloc_generic_pcode( reading->opcode,
-      reading->obj_pos );
-   append_pcode( reading, &generic->pcode );
+   struct generic_pcode* generic = append_generic_pcode( reading,
+      reading->opcode );
    i32 count = read_uint8( reading );
-   struct generic_pcode_arg* arg = alloc_generic_pcode_arg();
-   arg->value = count;
-   append_arg( generic, arg );
+   append_arg( reading, generic, count );
    for ( i32 i = 0; i < count; ++i ) {
-      struct generic_pcode_arg* arg = alloc_generic_pcode_arg();
-      arg->value = read_uint8( reading );
-      append_arg( generic, arg );
+      append_arg( reading, generic, read_uint8( reading ) );
    }
 }
 
+// The opcode is known to be supported, because the body has been validated.
 static void read_generic( struct loader* loader,
    struct pcode_reading* reading ) {
-   struct generic_pcode* generic = alloc_generic_pcode( reading->opcode,
-      reading->obj_pos );
-   append_pcode( reading, &generic->pcode );
-   struct pcode_info* pcode = c_get_pcode_info( generic->pcode.opcode );
-   if ( ! pcode ) {
-      t_diag( loader->task, DIAG_ERR,
-         "encountered unknown pcode (opcode: %d) at position %d",
-         generic->pcode.opcode, generic->pcode.obj_pos );
-      t_bail( loader->task );
+   const struct operand_layout* layout =
+      &loader->operand_layouts[ reading->opcode ];
+   struct generic_pcode* generic = append_generic_pcode( reading,
+      reading->opcode );
+   // Most instructions have no operands or a single operand.
+   switch ( layout->argc ) {
+   case 0:
+      break;
+   case 1:
+      append_arg( reading, generic,
+         read_operand( reading, layout->sizes[ 0 ] ) );
+      break;
+   default: {
+         i32* args = reserve_args( reading, generic, layout->argc );
+         for ( i32 i = 0; i < layout->argc; ++i ) {
+            args[ i ] = read_operand( reading, layout->sizes[ i ] );
+         }
+      }
    }
-   for ( i32 i = 0; i < pcode->argc; ++i ) {
-      read_generic_arg( loader, reading, generic, i );
+}
+
+static i32 read_operand( struct pcode_reading* reading, i32 size ) {
+   switch ( size ) {
+   case 1:
+      return read_uint8( reading );
+   case 2:
+      return read_int16( reading );
+   default:
+      return read_int32( reading );
    }
 }
 
-static struct generic_pcode* alloc_generic_pcode( i32 opcode, u32 obj_pos ) {
-   struct generic_pcode* generic = mem_alloc( sizeof( *generic ) );
-   init_pcode( &generic->pcode, opcode );
-   generic->pcode.obj_pos = ( i32 ) obj_pos;
+static struct generic_pcode* append_generic_pcode(
+   struct pcode_reading* reading, i32 opcode ) {
+   struct generic_pcode* generic = &append_pcode( reading, opcode )->generic;
    generic->args = NULL;
-   generic->args_tail = NULL;
+   generic->num_args = 0;
    return generic;
 }
 
-static void read_generic_arg( struct loader* loader,
-   struct pcode_reading* reading, struct generic_pcode* generic,
+// The operand sizes of every instruction are determined once per object file,
+// so decoding an instruction is a table lookup.
+static void init_operand_layouts( struct loader* loader ) {
+   for ( i32 opcode = 0; opcode < PCD_TOTAL; ++opcode ) {
+      struct operand_layout* layout = &loader->operand_layouts[ opcode ];
+      struct pcode_info* info = c_get_pcode_info( ( enum pcd ) opcode );
+      layout->argc = 0;
+      layout->size = 0;
+      layout->supported = true;
+      if ( info->argc > MAX_OPERANDS ) {
+         layout->supported = false;
+      }
+      else if ( info->argc > 0 ) {
+         layout->argc = info->argc;
+      }
+      for ( i32 i = 0; i < layout->argc; ++i ) {
+         i32 size = get_operand_size( loader, opcode, i );
+         layout->sizes[ i ] = ( u8 ) size;
+         layout->size += size;
+         if ( size == 0 ) {
+            layout->supported = false;
+         }
+      }
+   }
+}
+
+// Returns the size, in bytes, of an operand of an instruction, or 0 if the
+// instruction is not supported.
+static i32 get_operand_size( struct loader* loader, i32 opcode,
    i32 arg_number ) {
-   i32 value = 0;
-   switch ( reading->opcode ) {
+   switch ( opcode ) {
    // One argument instructions, with argument being 1-byte/4-bytes.
    case PCD_LSPEC1:
    case PCD_LSPEC2:
@@ -1796,47 +2612,43 @@ static void read_generic_arg( struct loader* loader,
    case PCD_LSSCRIPTARRAY:
    case PCD_RSSCRIPTARRAY:
       if ( loader->small_code ) {
-         value = read_uint8( reading );
+         return 1;
       }
       else {
-         value = read_int32( reading );
+         return 4;
       }
-      break;
    case PCD_LSPEC1DIRECT:
    case PCD_LSPEC2DIRECT:
    case PCD_LSPEC3DIRECT:
    case PCD_LSPEC4DIRECT:
    case PCD_LSPEC5DIRECT:
       if ( loader->small_code && arg_number == 0 ) {
-         value = read_uint8( reading );
+         return 1;
       }
       else {
-         value = read_int32( reading );
+         return 4;
       }
-      break;
    case PCD_CALLFUNC:
       if ( loader->small_code ) {
          // Argument-count field.
          if ( arg_number == 0 ) {
-            value = read_uint8( reading );
+            return 1;
          }
          // Function-index field.
          else {
-            value = read_int16( reading );
+            return 2;
          }
       }
       else {
-         value = read_int32( reading );
+         return 4;
       }
-      break;
    case PCD_PUSHNUMBER:
    case PCD_THINGCOUNTDIRECT:
    case PCD_SCRIPTWAITDIRECT:
    case PCD_CONSOLECOMMANDDIRECT:
    case PCD_LSPEC5EX:
    case PCD_LSPEC5EXRESULT:
-      value = read_int32( reading );
-      break;
+      return 4;
    case PCD_PUSHBYTE:
    case PCD_PUSH2BYTES:
    case PCD_PUSH3BYTES:
@@ -1849,169 +2661,284 @@ static void read_generic_arg( struct loader* loader,
    case PCD_LSPEC5DIRECTB:
    case PCD_DELAYDIRECTB:
    case PCD_RANDOMDIRECTB:
-      value = read_uint8( reading );
-      break;
+      return 1;
    default:
-      t_diag( loader->task, DIAG_INTERNAL | DIAG_ERR,
-         "unhandled pcode (%d) at: %s:%d", reading->opcode, __FILE__,
-         __LINE__ );
-      t_bail( loader->task );
+      return 0;
    }
-   struct generic_pcode_arg* arg = mem_alloc( sizeof( *arg ) );
-   arg->next = NULL;
-   arg->value = value;
-   append_arg( generic, arg );
 }
 
-static struct generic_pcode_arg* alloc_generic_pcode_arg( void ) {
-   struct generic_pcode_arg* arg = mem_alloc( sizeof( *arg ) );
-   arg->next = NULL;
-   arg->value = 0;
-   return arg;
+static void append_arg( struct pcode_reading* reading,
+   struct generic_pcode* generic, i32 value ) {
+   *reserve_args( reading, generic, 1 ) = value;
 }
 
-static void append_arg( struct generic_pcode* generic,
-   struct generic_pcode_arg* arg ) {
-   if ( generic->args ) {
-      generic->args_tail->next = arg;
-   }
-   else {
-      generic->args = arg;
-   }
-   generic->args_tail = arg;
+static i32* reserve_args( struct pcode_reading* reading,
+   struct generic_pcode* generic, i32 count ) {
+   struct pcode_buffer* buffer = reading->buffer;
+   i32* args = &buffer->args[ buffer->num_args ];
+   buffer->num_args += ( u32 ) count;
+   generic->num_args += count;
+   return args;
 }
 
 static void init_pcode( struct pcode* pcode, i32 opcode ) {
-   pcode->prev = NULL;
-   pcode->next = NULL;
    pcode->note = NULL;
    pcode->opcode = opcode;
    pcode->obj_pos = 0;
 }
 
 static void patch_script_jumps( struct task* task ) {
-   struct list_iter i;
-   list_iterate( &task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      struct script* script = list_data( &i );
+   for ( u32 i = 0; i < vec_size( &task->scripts ); ++i ) {
+      struct script* script = vec_at( &task->scripts, i );
       //struct jump_patch patch;
       //init_jump_patch( &patch, script->pcode );
       //patch_jumps( task, &patch );
-      list_next( &i );
    }
 }
 
-// For each script and function, this function connects the jump pcodes to
-// their destination pcodes.
-static void patch( struct task* task ) {
-   patch_scripts( task );
-   patch_funcs( task );
-}
-
-static void patch_scripts( struct task* task ) {
-   struct list_iter i;
-   list_iterate( &task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      struct script* script = list_data( &i );
-      struct patch patch;
-      init_patch( &patch, script->body_start, script->body_end );
-      patch_script( &patch );
-      list_next( &i );
+// A jump to the end of the body lands on the trailing sentinel.
+static void map_targets( struct pcode_reading* reading ) {
+   struct pcode_buffer* buffer = reading->buffer;
+   u32 size = reading->end_obj_pos - reading->start_obj_pos + 1;
+   if ( size > buffer->targets_capacity ) {
+      buffer->targets_capacity = size;
+      buffer->targets = mem_realloc( buffer->targets,
+         sizeof( buffer->targets[ 0 ] ) * size );
    }
-}
-
-static void patch_funcs( struct task* task ) {
-   struct list_iter i;
-   list_iterate( &task->funcs, &i );
-   while ( ! list_end( &i ) ) {
-      struct func* func = list_data( &i );
-      struct patch patch;
-      init_patch( &patch, func->more.user->start, func->more.user->end );
-      patch_script( &patch );
-      list_next( &i );
+   for ( u32 i = 0; i < size; ++i ) {
+      buffer->targets[ i ] = NULL;
    }
+   struct pcode* pcode = reading->start;
+   while ( pcode != PCODE_NEXT( reading->end ) ) {
+      buffer->targets[ ( u32 ) pcode->obj_pos - reading->start_obj_pos ] =
+         pcode;
+      pcode = PCODE_NEXT( pcode );
+   }
+   buffer->targets[ size - 1 ] = pcode;
 }
 
-static void init_patch( struct patch* patch, struct pcode* begin,
-   struct pcode* end ) {
-   patch->begin = begin;
-   patch->end = end;
-}
-
-static void patch_script( struct patch* patch ) {
-   struct pcode* pcode = patch->begin;
-   while ( pcode != patch->end->next ) {
+// Connects the jump pcodes of a script or function to their destination
+// pcodes.
+static void patch_body( struct pcode_reading* reading ) {
+   struct patch patch;
+   init_patch( &patch, reading );
+   struct pcode* pcode = reading->start;
+   while ( pcode != PCODE_NEXT( reading->end ) ) {
       switch ( pcode->opcode ) {
       case PCD_GOTO:
       case PCD_IFGOTO:
       case PCD_IFNOTGOTO:
-         patch_jump( patch,
+         patch_jump( reading, &patch,
             ( struct jump_pcode* ) pcode );
          break;
       case PCD_CASEGOTO:
-         patch_casejump( patch,
+         patch_casejump( reading, &patch,
             ( struct casejump_pcode* ) pcode );
          break;
       case PCD_CASEGOTOSORTED:
-         patch_sortedcasejump( patch,
+         patch_sortedcasejump( reading, &patch,
             ( struct sortedcasejump_pcode* ) pcode );
          break;
       default:
          break;
       }
-      pcode = pcode->next;
+      pcode = PCODE_NEXT( pcode );
    }
 }
 
-static void patch_jump( struct patch* patch, struct jump_pcode* jump ) {
-   jump->destination = find_destination( patch, &jump->pcode,
+static void init_patch( struct patch* patch, struct pcode_reading* reading ) {
+   patch->targets = reading->buffer->targets;
+   patch->start_obj_pos = reading->start_obj_pos;
+   patch->size = reading->end_obj_pos - reading->start_obj_pos + 1;
+}
+
+static void patch_jump( struct pcode_reading* reading, struct patch* patch,
+   struct jump_pcode* jump ) {
+   jump->destination = find_destination( reading, patch, &jump->pcode,
       jump->destination_obj_pos );
 }
 
-static void patch_casejump( struct patch* patch,
+static void patch_casejump( struct pcode_reading* reading, struct patch* patch,
    struct casejump_pcode* jump ) {
-   jump->destination = find_destination( patch, &jump->pcode,
+   jump->destination = find_destination( reading, patch, &jump->pcode,
       jump->destination_obj_pos );
 }
 
-static void patch_sortedcasejump( struct patch* patch,
+static void patch_sortedcasejump( struct pcode_reading* reading, struct patch* patch,
    struct sortedcasejump_pcode* jump ) {
-   struct casejump_pcode* case_jump = jump->head;
-   while ( case_jump ) {
-      patch_casejump( patch, case_jump );
-      case_jump = case_jump->next;
+   for ( i32 i = 0; i < jump->count; ++i ) {
+      patch_casejump( reading, patch, &jump->cases[ i ] );
    }
 }
 
-static struct pcode* find_destination( struct patch* patch,
-   struct pcode* jump, i32 obj_pos ) {
-   struct pcode* pcode = patch->begin;
-   struct pcode* end = jump;
-   if ( obj_pos > end->obj_pos ) {
-      pcode = end->next;
-      end = patch->end->next;
+static struct pcode* find_destination( struct pcode_reading* reading,
+   struct patch* patch, struct pcode* jump, i32 obj_pos ) {
+   u32 offset = ( u32 ) obj_pos - patch->start_obj_pos;
+   if ( ( u32 ) obj_pos < patch->start_obj_pos || offset >= patch->size ) {
+      decode_error( reading, DIAG_ERR,
+         "jump at position %d has a destination (position %d) outside of "
+         "the script or function it belongs to", jump->obj_pos, obj_pos );
    }
-   while ( pcode != end && pcode->obj_pos != obj_pos ) {
-      pcode = pcode->next;
+   struct pcode* pcode = patch->targets[ offset ];
+   if ( ! pcode ) {
+      decode_error( reading, DIAG_ERR,
+         "jump at position %d has a destination (position %d) in the middle "
+         "of an instruction", jump->obj_pos, obj_pos );
    }
    return pcode;
 }
 
+// The incoming jumps are first counted and then filled in, so the lists are
+// stored back to back, in the order of the jumps in the body.
+static void index_jumps( struct pcode_reading* reading,
+   struct jump_index* index ) {
+   index->start = reading->start;
+   index->num_slots = ( u32 ) ( ( union pcode_slot* ) reading->end -
+      ( union pcode_slot* ) reading->start ) + 2;
+   size_t size = sizeof( index->targets[ 0 ] ) * ( index->num_slots / 32 + 1 );
+   index->targets = mem_alloc( size );
+   memset( index->targets, 0, size );
+   size = sizeof( index->first_source[ 0 ] ) * ( index->num_slots + 1 );
+   index->first_source = mem_alloc( size );
+   memset( index->first_source, 0, size );
+   // The jumps to a pcode are counted in the entry after the pcode, so the
+   // running total leaves the start of each list in the entry of the pcode.
+   visit_jumps( reading, index, false );
+   for ( u32 i = 0; i < index->num_slots; ++i ) {
+      index->first_source[ i + 1 ] += index->first_source[ i ];
+   }
+   index->sources = mem_alloc( sizeof( index->sources[ 0 ] ) *
+      ( index->first_source[ index->num_slots ] + 1 ) );
+   // Filling in a list moves the start of the list to the start of the next
+   // list, so afterwards, the entries are moved back by one.
+   visit_jumps( reading, index, true );
+   for ( u32 i = index->num_slots; i > 0; --i ) {
+      index->first_source[ i ] = index->first_source[ i - 1 ];
+   }
+   index->first_source[ 0 ] = 0;
+}
+
+static void visit_jumps( struct pcode_reading* reading,
+   struct jump_index* index, bool fill ) {
+   struct pcode* pcode = reading->start;
+   while ( pcode != PCODE_NEXT( reading->end ) ) {
+      switch ( pcode->opcode ) {
+      case PCD_GOTO:
+      case PCD_IFGOTO:
+      case PCD_IFNOTGOTO:
+         add_jump( index, pcode,
+            ( ( struct jump_pcode* ) pcode )->destination, fill );
+         break;
+      case PCD_CASEGOTO:
+         add_jump( index, pcode,
+            ( ( struct casejump_pcode* ) pcode )->destination, fill );
+         break;
+      case PCD_CASEGOTOSORTED:
+         {
+            struct sortedcasejump_pcode* jump =
+               ( struct sortedcasejump_pcode* ) pcode;
+            for ( i32 i = 0; i < jump->count; ++i ) {
+               add_jump( index, pcode, jump->cases[ i ].destination, fill );
+            }
+         }
+         break;
+      default:
+         break;
+      }
+      pcode = PCODE_NEXT( pcode );
+   }
+}
+
+static void add_jump( struct jump_index* index, struct pcode* source,
+   struct pcode* destination, bool fill ) {
+   u32 slot = ( u32 ) ( ( union pcode_slot* ) destination -
+      ( union pcode_slot* ) index->start );
+   if ( fill ) {
+      index->sources[ index->first_source[ slot ] ] = source;
+      ++index->first_source[ slot ];
+   }
+   else {
+      index->targets[ slot / 32 ] |= 1u << ( slot % 32 );
+      ++index->first_source[ slot + 1 ];
+   }
+}
+
 void t_show( struct task* task ) {
-   struct list_iter i;
-   list_iterate( &task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      show_script( task, list_data( &i ) );
-      list_next( &i );
+   for ( u32 i = 0; i < vec_size( &task->scripts ); ++i ) {
+      struct script* script = vec_at( &task->scripts, i );
+      if ( script->selected ) {
+         show_script( task, script );
+      }
+   }
+}
+
+/**
+ * Releases the pcode of every script and function. The object file itself
+ * stays mapped, because the string table is decoded from it on demand.
+ */
+void t_unload( struct task* task ) {
+   for ( u32 i = 0; i < vec_size( &task->scripts ); ++i ) {
+      struct script* script = vec_at( &task->scripts, i );
+      script->body_start = NULL;
+      script->body_end = NULL;
+      init_jump_index( &script->jumps );
+   }
+   for ( u32 i = 0; i < vec_size( &task->funcs ); ++i ) {
+      struct func* func = vec_at( &task->funcs, i );
+      func->more.user->start = NULL;
+      func->more.user->end = NULL;
+      init_jump_index( &func->more.user->jumps );
    }
+   mem_arena_deinit( &task->load_region );
+   for ( u32 i = 0; i < vec_size( &task->decode_regions ); ++i ) {
+      mem_arena_deinit( vec_at( &task->decode_regions, i ) );
+   }
+}
+
+/**
+ * Tells whether a jump in the script or function goes to the pcode.
+ */
+bool t_is_jump_target( struct jump_index* index, struct pcode* pcode ) {
+   u32 slot = 0;
+   return ( find_jump_slot( index, pcode, &slot ) &&
+      ( index->targets[ slot / 32 ] & ( 1u << ( slot % 32 ) ) ) != 0 );
+}
+
+/**
+ * Returns the jumps to the pcode, in the order they appear in the script or
+ * function. A jump that has more than one case going to the pcode, like
+ * PCD_CASEGOTOSORTED, is listed once for each such case.
+ */
+struct pcode** t_find_jumps_to( struct jump_index* index, struct pcode* pcode,
+   u32* count ) {
+   u32 slot = 0;
+   if ( ! find_jump_slot( index, pcode, &slot ) ) {
+      *count = 0;
+      return NULL;
+   }
+   *count = index->first_source[ slot + 1 ] - index->first_source[ slot ];
+   return &index->sources[ index->first_source[ slot ] ];
+}
+
+static bool find_jump_slot( struct jump_index* index, struct pcode* pcode,
+   u32* slot ) {
+   union pcode_slot* start = ( union pcode_slot* ) index->start;
+   union pcode_slot* position = ( union pcode_slot* ) pcode;
+   if ( ! index->start || position < start ||
+      position >= start + index->num_slots ) {
+      return false;
+   }
+   *slot = ( u32 ) ( position - start );
+   return true;
 }
 
 static void show_script( struct task* task, struct script* script ) {
    struct pcode* pcode = script->body_start;
-   while ( pcode ) {
+   while ( pcode != PCODE_NEXT( script->body_end ) ) {
       printf( "> %d\n", pcode->opcode );
-      pcode = pcode->next;
+      pcode = PCODE_NEXT( pcode );
    }
+   printf( "> %d\n", pcode->opcode );
 }
 
 static void diag( struct loader* loader, u32 flags, ... ) {
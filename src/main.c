@@ -4,6 +4,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 
 #include "task.h"
 
@@ -12,40 +13,80 @@ struct diag_msg {
    i32 flags;
 };
 
+struct wad_header {
+   char id[ 4 ];
+   u32 num_lumps;
+   u32 directory_offset;
+};
+
+struct wad_entry {
+   u32 offset;
+   u32 size;
+   char name[ 8 ];
+};
+
+// Lump names are at most 8 characters long and are not always NUL-terminated.
+enum { LUMP_NAME_SIZE = 8 + 1 };
+
+// Name of an output file of a WAD file, without the extension. A name used by
+// an earlier lump gets a number appended to it.
+enum { OUTPUT_NAME_SIZE = LUMP_NAME_SIZE + 11 };
+
+struct wad_outputs {
+   char ( *names )[ OUTPUT_NAME_SIZE ];
+   u32 count;
+};
+
 static void init_options( struct options* options );
-static void read_options( struct options* options, char* argv[] );
+static void read_options( struct options* options, i32 argc, char* argv[] );
+static bool add_selection( struct options* options, i32 argc,
+   const char* option, const char* value, bool func );
 static void print_usage( char* path );
-static bool disassemble( struct options* options );
-static bool decompile( struct options* options );
-static void init_task( struct task* task, struct options* options );
+static bool process_object_file( struct options* options );
+static bool is_wad( const struct fs_mapped_file* file );
+static bool process_wad( struct options* options,
+   const struct fs_mapped_file* file );
+static void copy_lump_name( char* name, const struct wad_entry* entry );
+static bool process_lump( struct options* options,
+   const struct fs_mapped_file* file, struct wad_outputs* outputs,
+   const struct wad_entry* entry, const char* lump_name, const char* name );
+static bool is_safe_lump_name( const char* name );
+static void choose_output_name( struct wad_outputs* outputs,
+   const char* name, char* output_name );
+static bool output_name_used( struct wad_outputs* outputs, const char* name );
+static bool process_object( struct options* options,
+   struct object_input* input );
+static bool disassemble( struct options* options,
+   struct object_input* input );
+static bool decompile( struct options* options, struct object_input* input );
+static bool run_stages( struct options* options, struct object_input* input,
+   struct cache_entry* entry );
+static void init_task( struct task* task, struct options* options,
+   struct object_input* input );
+static void deinit_task( struct task* task );
+static void enter_stage( struct task* task, enum stage stage );
+static void print_mem_stats( struct task* task );
+static void print_site_stats( struct mem_site_stats* stats,
+   const char* name );
 static void init_diag_msg( struct task* task, struct diag_msg* msg, i32 flags,
    va_list* args );
 static void print_diag( struct task* task, struct diag_msg* msg );
 
 i32 main( i32 argc, char* argv[] ) {
-   mem_init();
    struct options options;
    init_options( &options );
-   read_options( &options, argv );
+   read_options( &options, argc, argv );
    i32 result = EXIT_FAILURE;
    if ( options.object_file ) {
-      if ( options.disassemble ) {
-         bool disassembled = disassemble( &options );
-         if ( disassembled ) {
-            result = EXIT_SUCCESS;
-         }
-      }
-      else {
-         bool decompiled = decompile( &options );
-         if ( decompiled ) {
-            result = EXIT_SUCCESS;
-         }
+      bool processed = process_object_file( &options );
+      if ( processed ) {
+         result = EXIT_SUCCESS;
       }
    }
    else {
       print_usage( argv[ 0 ] );
    }
-   mem_free_all();
+   free( options.selections );
    return result;
 }
 
@@ -53,9 +94,13 @@ static void init_options( struct options* options ) {
    options->object_file = NULL;
    options->source_file = NULL;
    options->disassemble = false;
+   options->mem_stats = false;
+   options->use_cache = true;
+   options->selections = NULL;
+   options->num_selections = 0;
 }
 
-static void read_options( struct options* options, char* argv[] ) {
+static void read_options( struct options* options, i32 argc, char* argv[] ) {
    char** args = argv + 1;
    while ( true ) {
       // Select option.
@@ -71,6 +116,20 @@ static void read_options( struct options* options, char* argv[] ) {
       if ( strcmp( option, "a" ) == 0 ) {
          options->disassemble = true;
       }
+      else if ( strcmp( option, "-mem-stats" ) == 0 ) {
+         options->mem_stats = true;
+      }
+      else if ( strcmp( option, "-no-cache" ) == 0 ) {
+         options->use_cache = false;
+      }
+      else if ( strcmp( option, "-script" ) == 0 ||
+         strcmp( option, "-func" ) == 0 ) {
+         if ( ! add_selection( options, argc, option, *args,
+            ( option[ 1 ] == 'f' ) ) ) {
+            return;
+         }
+         ++args;
+      }
       else {
          printf( "error: unknown option: %s\n", option );
          return;
@@ -85,49 +144,328 @@ static void read_options( struct options* options, char* argv[] ) {
    }
 }
 
+// There cannot be more selections than arguments, so the array is allocated
+// once, with room for every argument.
+static bool add_selection( struct options* options, i32 argc,
+   const char* option, const char* value, bool func ) {
+   if ( ! value ) {
+      printf( "error: missing argument for option: %s\n", option );
+      return false;
+   }
+   if ( ! options->selections ) {
+      options->selections = mem_system_alloc(
+         sizeof( *options->selections ) * ( size_t ) argc );
+   }
+   struct selection* selection =
+      &options->selections[ options->num_selections ];
+   selection->value = value;
+   selection->func = func;
+   ++options->num_selections;
+   return true;
+}
+
 static void print_usage( char* path ) {
    printf(
       "Usage: %s [options] <object-file> [output-file]\n"
+      "When the object file is a WAD file, every BEHAVIOR lump and every\n"
+      "lump between the A_START and A_END markers is decompiled, and the\n"
+      "output file is a directory that gets one file for each lump.\n"
       "Options:\n"
-      "  -a    Disassemble\n"
+      "  -a             Disassemble\n"
+      "  --mem-stats    Show memory usage statistics\n"
+      "  --no-cache     Do not use the output cache\n"
+      "  --script <number|name>\n"
+      "                 Decompile only the given script. Can be repeated\n"
+      "  --func <name>  Decompile only the given function. Can be repeated\n"
+      "When --script or --func is given, the functions called by the selected\n"
+      "scripts and functions are decompiled too.\n"
       "",
       path );
 }
 
-static bool disassemble( struct options* options ) {
+// The object file is mapped into memory once. A WAD file stays mapped while
+// each of its ACS lumps is processed.
+static bool process_object_file( struct options* options ) {
+   struct fs_mapped_file file;
+   if ( ! fs_map_file( options->object_file, &file ) ) {
+      printf( "error: failed to read object file: \"%s\": %s\n",
+         options->object_file, strerror( file.err ) );
+      return false;
+   }
+   bool processed = false;
+   if ( is_wad( &file ) ) {
+      processed = process_wad( options, &file );
+   }
+   else {
+      struct object_input input = { file.data, file.size, NULL,
+         options->source_file };
+      processed = process_object( options, &input );
+   }
+   fs_unmap_file( &file );
+   return processed;
+}
+
+static bool is_wad( const struct fs_mapped_file* file ) {
+   return ( file->size >= sizeof( struct wad_header ) && (
+      memcmp( file->data, "IWAD", 4 ) == 0 ||
+      memcmp( file->data, "PWAD", 4 ) == 0 ) );
+}
+
+// A BEHAVIOR lump is named after the map it belongs to. The map is named by
+// the marker lump that comes right before the first lump of the map.
+static bool process_wad( struct options* options,
+   const struct fs_mapped_file* file ) {
+   struct wad_header header;
+   memcpy( &header, file->data, sizeof( header ) );
+   if ( header.directory_offset > file->size || header.num_lumps >
+      ( file->size - header.directory_offset ) / sizeof( struct wad_entry ) ) {
+      printf( "error: WAD file has a directory that extends past the end of "
+         "the file\n" );
+      return false;
+   }
+   if ( options->source_file ) {
+      struct fs_query query;
+      fs_init_query( &query, options->source_file );
+      struct fs_result result;
+      if ( ! fs_exists( &query ) &&
+         ! fs_create_dir( options->source_file, &result ) ) {
+         printf( "error: failed to create output directory: \"%s\": %s\n",
+            options->source_file, strerror( errno ) );
+         return false;
+      }
+   }
+   struct wad_outputs outputs;
+   outputs.names = mem_system_alloc( sizeof( outputs.names[ 0 ] ) *
+      ( ( size_t ) header.num_lumps + 1 ) );
+   outputs.count = 0;
+   bool processed = true;
+   bool acs_namespace = false;
+   char map_name[ LUMP_NAME_SIZE ] = "BEHAVIOR";
+   char prev_name[ LUMP_NAME_SIZE ] = "";
+   const u8* directory = file->data + header.directory_offset;
+   for ( u32 i = 0; i < header.num_lumps; ++i ) {
+      struct wad_entry entry;
+      memcpy( &entry, directory + sizeof( entry ) * i, sizeof( entry ) );
+      char name[ LUMP_NAME_SIZE ];
+      copy_lump_name( name, &entry );
+      if ( strcmp( name, "A_START" ) == 0 ) {
+         acs_namespace = true;
+      }
+      else if ( strcmp( name, "A_END" ) == 0 ) {
+         acs_namespace = false;
+      }
+      else if ( strcmp( name, "THINGS" ) == 0 ||
+         strcmp( name, "TEXTMAP" ) == 0 ) {
+         memcpy( map_name, prev_name, sizeof( map_name ) );
+      }
+      else if ( strcmp( name, "BEHAVIOR" ) == 0 ) {
+         if ( ! process_lump( options, file, &outputs, &entry, NULL,
+            map_name ) ) {
+            processed = false;
+         }
+      }
+      else if ( acs_namespace && entry.size > 0 ) {
+         if ( ! process_lump( options, file, &outputs, &entry, name,
+            name ) ) {
+            processed = false;
+         }
+      }
+      memcpy( prev_name, name, sizeof( prev_name ) );
+   }
+   free( outputs.names );
+   return processed;
+}
+
+static void copy_lump_name( char* name, const struct wad_entry* entry ) {
+   memcpy( name, entry->name, sizeof( entry->name ) );
+   name[ sizeof( entry->name ) ] = '\0';
+}
+
+// Output written to standard output is preceded by the name of the lump, so
+// the output of one lump can be told apart from the output of another.
+static bool process_lump( struct options* options,
+   const struct fs_mapped_file* file, struct wad_outputs* outputs,
+   const struct wad_entry* entry, const char* lump_name, const char* name ) {
+   if ( ! is_safe_lump_name( name ) ) {
+      printf( "error: lump name cannot be used as a file name: \"%s\"\n",
+         name );
+      return false;
+   }
+   if ( entry->offset > file->size ||
+      entry->size > file->size - entry->offset ) {
+      printf( "error: %s lump extends past the end of the WAD file\n",
+         name );
+      return false;
+   }
+   struct object_input input = { file->data + entry->offset, entry->size,
+      lump_name, NULL };
+   char* path = NULL;
+   if ( options->source_file ) {
+      char* output_name = outputs->names[ outputs->count ];
+      choose_output_name( outputs, name, output_name );
+      ++outputs->count;
+      size_t length = strlen( options->source_file ) + strlen( OS_PATHSEP ) +
+         strlen( output_name ) + strlen( ".acs" ) + 1;
+      path = mem_system_alloc( length );
+      snprintf( path, length, "%s" OS_PATHSEP "%s.acs", options->source_file,
+         output_name );
+      input.output_file = path;
+   }
+   else {
+      printf( "// %s\n", name );
+   }
+   bool processed = process_object( options, &input );
+   free( path );
+   return processed;
+}
+
+// The name becomes part of the path of an output file, so it must not lead
+// out of the output directory. The name is checked as stored in the WAD file,
+// so a NUL character followed by other characters is refused too.
+static bool is_safe_lump_name( const char* name ) {
+   if ( name[ 0 ] == '\0' || strstr( name, ".." ) ) {
+      return false;
+   }
+   bool terminated = false;
+   for ( i32 i = 0; i < LUMP_NAME_SIZE - 1; ++i ) {
+      if ( name[ i ] == '\0' ) {
+         terminated = true;
+      }
+      else if ( terminated || name[ i ] == '/' || name[ i ] == '\\' ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+// Two maps can have the same name, and on some systems, file names that differ
+// only in case are the same file.
+static void choose_output_name( struct wad_outputs* outputs,
+   const char* name, char* output_name ) {
+   snprintf( output_name, OUTPUT_NAME_SIZE, "%s", name );
+   u32 number = 1;
+   while ( output_name_used( outputs, output_name ) ) {
+      ++number;
+      snprintf( output_name, OUTPUT_NAME_SIZE, "%s-%u", name, number );
+   }
+   if ( number > 1 ) {
+      printf( "warning: %s lump is written to %s.acs, because an earlier "
+         "lump has the same name\n", name, output_name );
+   }
+}
+
+static bool output_name_used( struct wad_outputs* outputs, const char* name ) {
+   for ( u32 i = 0; i < outputs->count; ++i ) {
+      if ( strcasecmp( outputs->names[ i ], name ) == 0 ) {
+         return true;
+      }
+   }
+   return false;
+}
+
+static bool process_object( struct options* options,
+   struct object_input* input ) {
+   if ( options->disassemble ) {
+      return disassemble( options, input );
+   }
+   else {
+      return decompile( options, input );
+   }
+}
+
+static bool disassemble( struct options* options,
+   struct object_input* input ) {
    bool disassembled = false;
    struct task task;
-   init_task( &task, options );
+   init_task( &task, options, input );
    if ( setjmp( task.bail ) == 0 ) {
       t_load( &task );
       t_show( &task );
       disassembled = true;
    }
+   deinit_task( &task );
    return disassembled;
 }
 
-static bool decompile( struct options* options ) {
+static bool decompile( struct options* options, struct object_input* input ) {
+   struct cache_entry entry;
+   t_init_cache_entry( &entry, options, input );
+   bool decompiled = false;
+   switch ( t_fetch_cache_entry( &entry, input->output_file ) ) {
+   case CACHE_HIT:
+      decompiled = true;
+      break;
+   case CACHE_MISS:
+      decompiled = run_stages( options, input, &entry );
+      break;
+   case CACHE_ERROR:
+      break;
+   }
+   t_deinit_cache_entry( &entry );
+   return decompiled;
+}
+
+// When the output is cached, the source code is written to the cache, and then
+// copied from there to the output. Output that comes with diagnostics is not
+// kept in the cache, so the diagnostics are shown every time.
+static bool run_stages( struct options* options, struct object_input* input,
+   struct cache_entry* entry ) {
+   struct object_input stage_input = *input;
+   if ( entry->path ) {
+      stage_input.output_file = entry->temp_path;
+   }
    bool decompiled = false;
    struct task task;
-   init_task( &task, options );
+   init_task( &task, options, &stage_input );
+   task.cache_dir = entry->dir;
    if ( setjmp( task.bail ) == 0 ) {
       t_create_builtins( &task );
       t_load( &task );
+      t_fetch_cached_bodies( &task );
+      enter_stage( &task, STAGE_ANNOTATE );
       t_annotate( &task );
+      enter_stage( &task, STAGE_RECOVER );
       t_recover( &task );
+      // The pcode and its notes are not needed once the AST is built.
+      mem_arena_deinit( &task.annotate_region );
+      t_unload( &task );
+      enter_stage( &task, STAGE_ANALYZE );
       t_analyze( &task );
+      enter_stage( &task, STAGE_PUBLISH );
       t_publish( &task );
       decompiled = true;
    }
+   bool keep = ( task.num_diags == 0 );
+   deinit_task( &task );
+   if ( decompiled && entry->path ) {
+      decompiled = t_store_cache_entry( entry, keep, input->output_file );
+   }
    return decompiled;
 }
 
-static void init_task( struct task* task, struct options* options ) {
+static void init_task( struct task* task, struct options* options,
+   struct object_input* input ) {
+   // Everything allocated for the task comes from the task's own arena.
+   mem_arena_init( &task->arena );
+   mem_arena_init( &task->load_region );
+   mem_arena_init( &task->annotate_region );
+   mem_arena_init( &task->body_region );
+   mem_stats_init( &task->mem_stats );
+   if ( options->mem_stats ) {
+      mem_arena_track( &task->arena, &task->mem_stats );
+      mem_arena_track( &task->load_region, &task->mem_stats );
+      mem_arena_track( &task->annotate_region, &task->mem_stats );
+      mem_arena_track( &task->body_region, &task->mem_stats );
+   }
+   mem_select_arena( &task->arena );
+   str_table_init( &task->str_table );
+   task->input = *input;
    task->options = options;
    str_init( &task->library_name );
-   list_init( &task->objects );
-   list_init( &task->scripts );
-   list_init( &task->funcs );
+   vec_init( &task->decode_regions );
+   vec_init( &task->objects );
+   vec_init( &task->scripts );
+   vec_init( &task->funcs );
    list_init( &task->imports );
    for ( u32 i = 0; i < ARRAY_SIZE( task->map_vars ); ++i ) {
       task->map_vars[ i ] = NULL;
@@ -142,6 +480,12 @@ static void init_task( struct task* task, struct options* options ) {
    }
    task->strings = NULL;
    task->num_strings = 0u;
+   task->string_source.data = NULL;
+   task->string_source.offsets = NULL;
+   task->string_source.size = 0;
+   task->string_source.name = NULL;
+   task->cache_dir = NULL;
+   task->num_diags = 0;
    task->encrypt_str = false;
    task->importable = false;
    task->compact = false;
@@ -150,6 +494,67 @@ static void init_task( struct task* task, struct options* options ) {
    task->calls_ext = false;
 }
 
+static void deinit_task( struct task* task ) {
+   if ( task->options->mem_stats ) {
+      print_mem_stats( task );
+   }
+   mem_select_arena( NULL );
+   mem_arena_deinit( &task->body_region );
+   mem_arena_deinit( &task->annotate_region );
+   mem_arena_deinit( &task->load_region );
+   for ( u32 i = 0; i < vec_size( &task->decode_regions ); ++i ) {
+      mem_arena_deinit( vec_at( &task->decode_regions, i ) );
+   }
+   mem_arena_deinit( &task->arena );
+}
+
+static void enter_stage( struct task* task, enum stage stage ) {
+   mem_stats_set_phase( &task->mem_stats, stage );
+}
+
+static void print_mem_stats( struct task* task ) {
+   static const char* site_names[] = {
+      "mem_alloc",
+      "mem_slot_alloc",
+      "str",
+      "list_link",
+   };
+   static const char* stage_names[] = {
+      "load",
+      "annotate",
+      "recover",
+      "analyze",
+      "publish",
+   };
+   STATIC_ASSERT( ARRAY_SIZE( site_names ) == MEM_SITE_TOTAL );
+   STATIC_ASSERT( ARRAY_SIZE( stage_names ) == STAGE_TOTAL );
+   fprintf( stderr, "%-16s %10s %12s %12s %14s\n", "memory", "calls",
+      "bytes", "peak-live", "freelist-hits" );
+   for ( i32 i = 0; i < MEM_SITE_TOTAL; ++i ) {
+      print_site_stats( &task->mem_stats.sites[ i ], site_names[ i ] );
+   }
+   for ( i32 stage = 0; stage < STAGE_TOTAL; ++stage ) {
+      fprintf( stderr, "%s:\n", stage_names[ stage ] );
+      for ( i32 i = 0; i < MEM_SITE_TOTAL; ++i ) {
+         print_site_stats( &task->mem_stats.phases[ stage ][ i ],
+            site_names[ i ] );
+      }
+   }
+}
+
+static void print_site_stats( struct mem_site_stats* stats,
+   const char* name ) {
+   fprintf( stderr, "  %-14s %10zu %12zu %12zu", name, stats->calls,
+      stats->bytes, stats->peak );
+   if ( stats->calls > 0 ) {
+      fprintf( stderr, " %13.1f%%\n",
+         100.0 * ( double ) stats->reused / ( double ) stats->calls );
+   }
+   else {
+      fprintf( stderr, " %14s\n", "-" );
+   }
+}
+
 bool t_uses_zcommon_file( struct task* task ) {
    return ( task->calls_aspec || task->calls_ext );
 }
@@ -197,13 +602,14 @@ static void init_diag_msg( struct task* task, struct diag_msg* msg, i32 flags,
 
 static void print_diag( struct task* task, struct diag_msg* msg ) {
    printf( "%s\n", msg->text.value );
+   ++task->num_diags;
 }
 
 struct func* t_alloc_func( void ) {
    struct func* func = mem_slot_alloc( sizeof( *func ) );
    func->node.type = NODE_FUNC;
    func->type = FUNC_ASPEC;
-   str_init( &func->name );
+   func->name = NULL;
    list_init( &func->params );
    func->return_spec = SPEC_VOID;
    func->min_param = 0;
@@ -217,11 +623,3 @@ struct param* t_alloc_param( void ) {
    return param;
 }
 
-const char* t_lookup_string( struct task* task, u32 index ) {
-   if ( index < task->num_strings ) {
-      return task->strings[ index ].value;
-   }
-   else {
-      return NULL;
-   }
-}
@@ -412,6 +412,378 @@ struct pcode_info* c_get_pcode_info( enum pcd opcode ) {
    return &pcode_info[ opcode ];
 }
 
+// Pcode that are not listed cannot be part of an expression.
+static const struct stack_effect g_stack_effect_table[ PCD_TOTAL ] = {
+   // Literals. PCD_PUSHBYTES pushes as many values as its first argument says.
+   [ PCD_PUSHNUMBER ] = { OPERAND_LITERAL, 0, 1 },
+   [ PCD_PUSHBYTE ] = { OPERAND_LITERAL, 0, 1 },
+   [ PCD_PUSH2BYTES ] = { OPERAND_LITERAL, 0, 2 },
+   [ PCD_PUSH3BYTES ] = { OPERAND_LITERAL, 0, 3 },
+   [ PCD_PUSH4BYTES ] = { OPERAND_LITERAL, 0, 4 },
+   [ PCD_PUSH5BYTES ] = { OPERAND_LITERAL, 0, 5 },
+   [ PCD_PUSHBYTES ] = { OPERAND_LITERAL, 0, STACK_VARIADIC },
+
+   // Stack manipulation.
+   [ PCD_DUP ] = { OPERAND_DUP, 0, 1 },
+   [ PCD_DROP ] = { OPERAND_DROP, 1, 0 },
+
+   // Variables and arrays.
+   [ PCD_PUSHSCRIPTVAR ] = { OPERAND_PUSHVAR, 0, 1 },
+   [ PCD_PUSHMAPVAR ] = { OPERAND_PUSHVAR, 0, 1 },
+   [ PCD_PUSHWORLDVAR ] = { OPERAND_PUSHVAR, 0, 1 },
+   [ PCD_PUSHGLOBALVAR ] = { OPERAND_PUSHVAR, 0, 1 },
+   [ PCD_PUSHSCRIPTARRAY ] = { OPERAND_PUSHARRAY, 1, 1 },
+   [ PCD_PUSHMAPARRAY ] = { OPERAND_PUSHARRAY, 1, 1 },
+   [ PCD_PUSHWORLDARRAY ] = { OPERAND_PUSHARRAY, 1, 1 },
+   [ PCD_PUSHGLOBALARRAY ] = { OPERAND_PUSHARRAY, 1, 1 },
+   [ PCD_INCSCRIPTVAR ] = { OPERAND_INC, 0, 0 },
+   [ PCD_INCMAPVAR ] = { OPERAND_INC, 0, 0 },
+   [ PCD_INCWORLDVAR ] = { OPERAND_INC, 0, 0 },
+   [ PCD_INCGLOBALVAR ] = { OPERAND_INC, 0, 0 },
+   [ PCD_DECSCRIPTVAR ] = { OPERAND_INC, 0, 0 },
+   [ PCD_DECMAPVAR ] = { OPERAND_INC, 0, 0 },
+   [ PCD_DECWORLDVAR ] = { OPERAND_INC, 0, 0 },
+   [ PCD_DECGLOBALVAR ] = { OPERAND_INC, 0, 0 },
+   [ PCD_INCSCRIPTARRAY ] = { OPERAND_ARRAYINC, 1, 0 },
+   [ PCD_INCMAPARRAY ] = { OPERAND_ARRAYINC, 1, 0 },
+   [ PCD_INCWORLDARRAY ] = { OPERAND_ARRAYINC, 1, 0 },
+   [ PCD_INCGLOBALARRAY ] = { OPERAND_ARRAYINC, 1, 0 },
+   [ PCD_DECSCRIPTARRAY ] = { OPERAND_ARRAYINC, 1, 0 },
+   [ PCD_DECMAPARRAY ] = { OPERAND_ARRAYINC, 1, 0 },
+   [ PCD_DECWORLDARRAY ] = { OPERAND_ARRAYINC, 1, 0 },
+   [ PCD_DECGLOBALARRAY ] = { OPERAND_ARRAYINC, 1, 0 },
+   [ PCD_ASSIGNSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ADDSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_SUBSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_MULSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_DIVSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_MODSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ANDSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_EORSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ORSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_LSSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_RSSCRIPTVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ASSIGNMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ADDMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_SUBMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_MULMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_DIVMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_MODMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ANDMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_EORMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ORMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_LSMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_RSMAPVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ASSIGNWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ADDWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_SUBWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_MULWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_DIVWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_MODWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ANDWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_EORWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ORWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_LSWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_RSWORLDVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ASSIGNGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ADDGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_SUBGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_MULGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_DIVGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_MODGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ANDGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_EORGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ORGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_LSGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_RSGLOBALVAR ] = { OPERAND_ASSIGN, 1, 0 },
+   [ PCD_ASSIGNSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ADDSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_SUBSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_MULSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_DIVSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_MODSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ANDSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_EORSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ORSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_LSSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_RSSCRIPTARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ASSIGNMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ADDMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_SUBMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_MULMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_DIVMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_MODMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ANDMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_EORMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ORMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_LSMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_RSMAPARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ASSIGNWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ADDWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_SUBWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_MULWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_DIVWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_MODWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ANDWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_EORWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ORWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_LSWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_RSWORLDARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ASSIGNGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ADDGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_SUBGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_MULGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_DIVGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_MODGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ANDGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_EORGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_ORGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_LSGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+   [ PCD_RSGLOBALARRAY ] = { OPERAND_ASSIGNARRAY, 2, 0 },
+
+   // Operators.
+   [ PCD_ORLOGICAL ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_ANDLOGICAL ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_ORBITWISE ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_EORBITWISE ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_ANDBITWISE ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_EQ ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_NE ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_LT ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_LE ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_GT ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_GE ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_LSHIFT ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_RSHIFT ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_ADD ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_SUBTRACT ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_MULTIPLY ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_DIVIDE ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_MODULUS ] = { OPERAND_BINARY, 2, 1 },
+   [ PCD_NEGATELOGICAL ] = { OPERAND_UNARY, 1, 1 },
+   [ PCD_NEGATEBINARY ] = { OPERAND_UNARY, 1, 1 },
+   [ PCD_UNARYMINUS ] = { OPERAND_MINUS, 1, 1 },
+   [ PCD_TAGSTRING ] = { OPERAND_TAGSTRING, 1, 1 },
+
+   // Action specials. The direct forms take their arguments from the pcode.
+   [ PCD_LSPEC1 ] = { OPERAND_ASPEC, 1, 0 },
+   [ PCD_LSPEC2 ] = { OPERAND_ASPEC, 2, 0 },
+   [ PCD_LSPEC3 ] = { OPERAND_ASPEC, 3, 0 },
+   [ PCD_LSPEC4 ] = { OPERAND_ASPEC, 4, 0 },
+   [ PCD_LSPEC5 ] = { OPERAND_ASPEC, 5, 0 },
+   [ PCD_LSPEC1DIRECT ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC2DIRECT ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC3DIRECT ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC4DIRECT ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC5DIRECT ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC1DIRECTB ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC2DIRECTB ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC3DIRECTB ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC4DIRECTB ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC5DIRECTB ] = { OPERAND_ASPECDIRECT, 0, 0 },
+   [ PCD_LSPEC5RESULT ] = { OPERAND_ASPECFIXED, 5, 1 },
+   [ PCD_LSPEC5EX ] = { OPERAND_ASPECFIXED, 5, 0 },
+   [ PCD_LSPEC5EXRESULT ] = { OPERAND_ASPECFIXED, 5, 1 },
+
+   // Functions. How many values a dedicated function pops, and whether it
+   // pushes one, is given by the function itself.
+   [ PCD_DELAY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_RANDOM ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_THINGCOUNT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_TAGWAIT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_POLYWAIT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHANGEFLOOR ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHANGECEILING ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_LINESIDE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SCRIPTWAIT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CLEARLINESPECIAL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERCOUNT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GAMETYPE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GAMESKILL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_TIMER ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SECTORSOUND ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_AMBIENTSOUND ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SOUNDSEQUENCE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETLINETEXTURE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETLINEBLOCKING ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETLINESPECIAL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_THINGSOUND ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_ACTIVATORSOUND ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_LOCALAMBIENTSOUND ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETLINEMONSTERBLOCKING ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_ISNETWORKGAME ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERTEAM ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERHEALTH ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERARMORPOINTS ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERFRAGS ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_BLUETEAMCOUNT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_REDTEAMCOUNT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_BLUETEAMSCORE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_REDTEAMSCORE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_ISONEFLAGCTF ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETINVASIONWAVE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETINVASIONSTATE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_MUSICCHANGE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CONSOLECOMMAND ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SINGLEPLAYER ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_FIXEDMUL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_FIXEDDIV ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETGRAVITY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETAIRCONTROL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CLEARINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GIVEINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_TAKEINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHECKINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SPAWN ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SPAWNSPOT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETMUSIC ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_LOCALSETMUSIC ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETFONT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETTHINGSPECIAL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_FADETO ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_FADERANGE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CANCELFADE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYMOVIE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETFLOORTRIGGER ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETCEILINGTRIGGER ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORX ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORZ ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SIN ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_COS ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_VECTORANGLE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHECKWEAPON ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETWEAPON ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETMARINEWEAPON ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETACTORPROPERTY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORPROPERTY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERNUMBER ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_ACTIVATORTID ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETMARINESPRITE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETSCREENWIDTH ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETSCREENHEIGHT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_THINGPROJECTILE2 ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_STRLEN ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETHUDSIZE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETCVAR ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETRESULTVALUE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETLINEROWOFFSET ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORFLOORZ ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORANGLE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETSECTORFLOORZ ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETSECTORCEILINGZ ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETSIGILPIECES ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETLEVELINFO ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHANGESKY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERINGAME ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERISBOT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETCAMERATOTEXTURE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETAMMOCAPACITY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETAMMOCAPACITY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETACTORANGLE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SPAWNPROJECTILE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETSECTORLIGHTLEVEL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORCEILINGZ ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETACTORPOSITION ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CLEARACTORINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GIVEACTORINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_TAKEACTORINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHECKACTORINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_THINGCOUNTNAME ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SPAWNSPOTFACING ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_PLAYERCLASS ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETPLAYERINFO ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHANGELEVEL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SECTORDAMAGE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_REPLACETEXTURES ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORPITCH ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETACTORPITCH ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETACTORSTATE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_THINGDAMAGE2 ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_USEINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_USEACTORINVENTORY ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHECKACTORCEILINGTEXTURE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHECKACTORFLOORTEXTURE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETACTORLIGHTLEVEL ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SETMUGSHOTSTATE ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_THINGCOUNTSECTOR ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_THINGCOUNTNAMESECTOR ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CHECKPLAYERCAMERA ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_MORPHACTOR ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_UNMORPHACTOR ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_GETPLAYERINPUT ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_CLASSIFYACTOR ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_SCRIPTWAITNAMED ] = { OPERAND_DED, STACK_VARIADIC, STACK_VARIADIC },
+   [ PCD_DELAYDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_RANDOMDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_THINGCOUNTDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_TAGWAITDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_POLYWAITDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_CHANGEFLOORDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_CHANGECEILINGDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_SCRIPTWAITDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_CONSOLECOMMANDDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_SETGRAVITYDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_SETAIRCONTROLDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_GIVEINVENTORYDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_TAKEINVENTORYDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_CHECKINVENTORYDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_SPAWNDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_SPAWNSPOTDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_SETMUSICDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_LOCALSETMUSICDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_SETSTYLEDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_SETFONTDIRECT ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_DELAYDIRECTB ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_RANDOMDIRECTB ] = { OPERAND_DEDDIRECT, 0, STACK_VARIADIC },
+   [ PCD_CALL ] = { OPERAND_CALLUSER, STACK_VARIADIC, 1 },
+   [ PCD_CALLDISCARD ] = { OPERAND_CALLUSER, STACK_VARIADIC, 0 },
+   [ PCD_CALLFUNC ] = { OPERAND_CALLEXT, STACK_VARIADIC, 1 },
+
+   // Printing. The HUD message pcode pop the values pushed since
+   // PCD_MOREHUDMESSAGE.
+   [ PCD_BEGINPRINT ] = { OPERAND_BEGINPRINT, 0, 0 },
+   [ PCD_PRINTSTRING ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTNUMBER ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTCHARACTER ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTFIXED ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTNAME ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTLOCALIZED ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTBIND ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTBINARY ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTHEX ] = { OPERAND_PRINTVALUE, 1, 0 },
+   [ PCD_PRINTMAPCHARARRAY ] = { OPERAND_PRINTARRAY, 2, 0 },
+   [ PCD_PRINTMAPCHRANGE ] = { OPERAND_PRINTARRAY, 4, 0 },
+   [ PCD_PRINTWORLDCHARARRAY ] = { OPERAND_PRINTARRAY, 2, 0 },
+   [ PCD_PRINTWORLDCHRANGE ] = { OPERAND_PRINTARRAY, 4, 0 },
+   [ PCD_PRINTGLOBALCHARARRAY ] = { OPERAND_PRINTARRAY, 2, 0 },
+   [ PCD_PRINTGLOBALCHRANGE ] = { OPERAND_PRINTARRAY, 4, 0 },
+   [ PCD_MOREHUDMESSAGE ] = { OPERAND_MOREHUDMESSAGE, 0, 0 },
+   [ PCD_OPTHUDMESSAGE ] = { OPERAND_OPTHUDMESSAGE, 0, 0 },
+   [ PCD_ENDPRINT ] = { OPERAND_ENDPRINT, 0, 0 },
+   [ PCD_ENDPRINTBOLD ] = { OPERAND_ENDPRINT, 0, 0 },
+   [ PCD_ENDHUDMESSAGE ] = { OPERAND_ENDHUDMESSAGE, STACK_VARIADIC, 0 },
+   [ PCD_ENDHUDMESSAGEBOLD ] = { OPERAND_ENDHUDMESSAGE, STACK_VARIADIC, 0 },
+   [ PCD_ENDLOG ] = { OPERAND_ENDPRINT, 0, 0 },
+   [ PCD_SAVESTRING ] = { OPERAND_SAVESTRING, 0, 1 },
+   [ PCD_STRCPYTOMAPCHRANGE ] = { OPERAND_STRCPY, 6, 1 },
+   [ PCD_STRCPYTOWORLDCHRANGE ] = { OPERAND_STRCPY, 6, 1 },
+   [ PCD_STRCPYTOGLOBALCHRANGE ] = { OPERAND_STRCPY, 6, 1 },
+
+   // Translations.
+   [ PCD_STARTTRANSLATION ] = { OPERAND_STARTTRANSLATION, 1, 0 },
+   [ PCD_TRANSLATIONRANGE1 ] = { OPERAND_TRANSLATIONRANGE, 4, 0 },
+   [ PCD_TRANSLATIONRANGE2 ] = { OPERAND_TRANSLATIONRANGE, 8, 0 },
+   [ PCD_TRANSLATIONRANGE3 ] = { OPERAND_TRANSLATIONRANGE, 8, 0 },
+   [ PCD_TRANSLATIONRANGE4 ] = { OPERAND_TRANSLATIONRANGE, 5, 0 },
+   [ PCD_TRANSLATIONRANGE5 ] = { OPERAND_TRANSLATIONRANGE, 6, 0 },
+   [ PCD_ENDTRANSLATION ] = { OPERAND_ENDTRANSLATION, 0, 0 },
+};
+
+const struct stack_effect* c_get_stack_effect( enum pcd opcode ) {
+   return &g_stack_effect_table[ opcode ];
+}
+
 static struct direct_pcode_info g_direct_pcode_table[] = {
    { PCD_LSPEC1, PCD_LSPEC1DIRECT, 1 },
    { PCD_LSPEC2, PCD_LSPEC2DIRECT, 2 },
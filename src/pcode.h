@@ -606,4 +606,54 @@ struct direct_pcode_info {
    i32 argc;
 };
 
+// What a pcode does in an expression. The Annotation stage and the Recovery
+// stage both go by this, so they agree on where an expression starts and ends.
+enum operand_kind {
+   OPERAND_NONE,
+   OPERAND_LITERAL,
+   OPERAND_DUP,
+   OPERAND_DROP,
+   OPERAND_PUSHVAR,
+   OPERAND_PUSHARRAY,
+   OPERAND_INC,
+   OPERAND_ARRAYINC,
+   OPERAND_ASSIGN,
+   OPERAND_ASSIGNARRAY,
+   OPERAND_BINARY,
+   OPERAND_UNARY,
+   OPERAND_MINUS,
+   OPERAND_TAGSTRING,
+   OPERAND_ASPEC,
+   OPERAND_ASPECDIRECT,
+   OPERAND_ASPECFIXED,
+   OPERAND_DED,
+   OPERAND_DEDDIRECT,
+   OPERAND_CALLUSER,
+   OPERAND_CALLEXT,
+   OPERAND_BEGINPRINT,
+   OPERAND_PRINTVALUE,
+   OPERAND_PRINTARRAY,
+   OPERAND_MOREHUDMESSAGE,
+   OPERAND_OPTHUDMESSAGE,
+   OPERAND_ENDHUDMESSAGE,
+   OPERAND_ENDPRINT,
+   OPERAND_SAVESTRING,
+   OPERAND_STRCPY,
+   OPERAND_STARTTRANSLATION,
+   OPERAND_TRANSLATIONRANGE,
+   OPERAND_ENDTRANSLATION
+};
+
+// The number of values popped or pushed depends on the arguments of the pcode
+// or on the function it calls.
+enum { STACK_VARIADIC = -1 };
+
+struct stack_effect {
+   enum operand_kind kind;
+   i32 pops;
+   i32 pushes;
+};
+
+const struct stack_effect* c_get_stack_effect( enum pcd opcode );
+
 #endif
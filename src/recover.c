@@ -16,6 +16,7 @@ struct recovery {
    struct task* task;
    struct script* script;
    struct func* func;
+   struct cached_body* body;
 };
 
 struct stmt_recovery {
@@ -29,7 +30,7 @@ struct expr_recovery {
    struct format_call_recovery* format_call;
    struct paltrans* trans;
    struct expr* output_node;
-   struct list stack;
+   struct vec stack;
    bool done;
 };
 
@@ -202,20 +203,22 @@ static void init_recovery( struct recovery* recovery, struct task* task ) {
    recovery->task = task;
    recovery->script = NULL;
    recovery->func = NULL;
+   recovery->body = NULL;
 }
 
 static void recover_script_list( struct recovery* recovery ) {
-   struct list_iter i;
-   list_iterate( &recovery->task->scripts, &i );
-   while ( ! list_end( &i ) ) {
-      recover_script( recovery, list_data( &i ) );
-      list_next( &i );
+   for ( u32 i = 0; i < vec_size( &recovery->task->scripts ); ++i ) {
+      struct script* script = vec_at( &recovery->task->scripts, i );
+      if ( script->selected && ! script->cache.text ) {
+         recover_script( recovery, script );
+      }
    }
 }
 
 static void recover_script( struct recovery* recovery,
    struct script* script ) {
    recovery->script = script;
+   recovery->body = &script->cache;
    recover_script_param_list( recovery );
    struct stmt_recovery body;
    init_stmt_recovery( &body,
@@ -224,6 +227,7 @@ static void recover_script( struct recovery* recovery,
    recover_block( recovery, &body );
    script->body = body.block;
    recovery->script = NULL;
+   recovery->body = NULL;
 }
 
 static void recover_script_param_list( struct recovery* recovery ) {
@@ -259,21 +263,22 @@ static void recover_script_param( struct recovery* recovery,
       break;
    }
    if ( name ) {
-      str_append( &var->name, name );
+      var->name = str_table_intern( &recovery->task->str_table, name );
    }
 }
 
 static void recover_func_list( struct recovery* recovery ) {
-   struct list_iter i;
-   list_iterate( &recovery->task->funcs, &i );
-   while ( ! list_end( &i ) ) {
-      recover_func( recovery, list_data( &i ) );
-      list_next( &i );
+   for ( u32 i = 0; i < vec_size( &recovery->task->funcs ); ++i ) {
+      struct func* func = vec_at( &recovery->task->funcs, i );
+      if ( func->more.user->selected && ! func->more.user->cache.text ) {
+         recover_func( recovery, func );
+      }
    }
 }
 
 static void recover_func( struct recovery* recovery, struct func* func ) {
    recovery->func = func;
+   recovery->body = &func->more.user->cache;
    struct stmt_recovery body;
    init_stmt_recovery( &body,
       func->more.user->start,
@@ -281,6 +286,7 @@ static void recover_func( struct recovery* recovery, struct func* func ) {
    recover_block( recovery, &body );
    func->more.user->body = body.block;
    recovery->func = NULL;
+   recovery->body = NULL;
 }
 
 static void init_stmt_recovery( struct stmt_recovery* recovery,
@@ -297,7 +303,7 @@ static void recover_block( struct recovery* recovery,
       if ( ! stmt_recovery->output_node ) {
          break;
       }
-      list_append( &block->stmts, stmt_recovery->output_node );
+      vec_append( &block->stmts, stmt_recovery->output_node );
    }
    stmt_recovery->output_node = &block->node;
    stmt_recovery->block = block;
@@ -306,7 +312,7 @@ static void recover_block( struct recovery* recovery,
 static struct block* alloc_block( void ) {
    struct block* block = mem_alloc( sizeof( *block ) );
    block->node.type = NODE_BLOCK;
-   list_init( &block->stmts );
+   vec_init( &block->stmts );
    return block;
 }
 
@@ -506,17 +512,14 @@ static void recover_for( struct recovery* recovery,
    struct expr_recovery expr;
    init_expr_recovery( &expr, note->cond_start, note->cond_end );
    recover_expr( recovery, &expr );
-   struct list post;
-   list_init( &post );
-   struct list_iter i;
-   list_iterate( &note->post, &i );
-   while ( ! list_end( &i ) ) {
-      struct for_note_post* post_expr = list_data( &i );
+   struct vec post;
+   vec_init( &post );
+   for ( u32 i = 0; i < vec_size( &note->post ); ++i ) {
+      struct for_note_post* post_expr = vec_at( &note->post, i );
       struct expr_recovery expr;
       init_expr_recovery( &expr, post_expr->start, post_expr->end );
       recover_expr( recovery, &expr );
-      list_append( &post, expr.output_node );
-      list_next( &i );
+      vec_append( &post, expr.output_node );
    }
    struct stmt_recovery body;
    init_stmt_recovery( &body, note->body_start, note->body_end );
@@ -533,7 +536,7 @@ static struct for_stmt* alloc_for( void ) {
    struct for_stmt* stmt = mem_alloc( sizeof( *stmt ) );
    stmt->node.type = NODE_FOR;
    stmt->cond = NULL;
-   list_init( &stmt->post );
+   vec_init( &stmt->post );
    stmt->body = NULL;
    return stmt;
 }
@@ -603,7 +606,7 @@ static void examine_returnvoid( struct recovery* recovery,
 static void recover_inline_asm( struct stmt_recovery* recovery ) {
    struct inline_asm* inline_asm = mem_alloc( sizeof( *inline_asm ) );
    inline_asm->node.type = NODE_INLINEASM;
-   inline_asm->pcode = recovery->range.pcode;
+   inline_asm->opcode = recovery->range.pcode->opcode;
    recovery->output_node = &inline_asm->node;
    next_pcode( &recovery->range );
 }
@@ -614,7 +617,7 @@ static void init_expr_recovery( struct expr_recovery* recovery,
    recovery->format_call = NULL;
    recovery->trans = NULL;
    recovery->output_node = NULL;
-   list_init( &recovery->stack );
+   vec_init( &recovery->stack );
    recovery->done = false;
 }
 
@@ -627,27 +630,27 @@ static struct expr* alloc_expr( void ) {
 
 static void push( struct expr_recovery* recovery, struct node* node,
    enum precedence precedence ) {
-   struct operand* operand = mem_alloc( sizeof( *operand ) );
+   struct operand* operand = mem_slot_alloc( sizeof( *operand ) );
    operand->node = node;
    operand->precedence = precedence;
-   list_prepend( &recovery->stack, operand );
+   vec_append( &recovery->stack, operand );
 }
 
 static struct node* pop( struct recovery* recovery,
    struct expr_recovery* expr_recovery, enum precedence parent_precedence ) {
-   if ( list_size( &expr_recovery->stack ) == 0 ) {
+   if ( vec_size( &expr_recovery->stack ) == 0 ) {
       t_diag( recovery->task, DIAG_INTERNAL | DIAG_ERR,
          "attempting to pop operand, but stack size is 0" );
       t_bail( recovery->task );
    }
-   struct operand* operand = list_shift( &expr_recovery->stack );
+   struct operand* operand = vec_pop( &expr_recovery->stack );
    if ( operand->precedence < parent_precedence ) {
       struct paren* paren = alloc_paren();
       paren->contents = operand->node;
       operand->node = &paren->node;
    }
    struct node* node = operand->node;
-   mem_free( operand );
+   mem_slot_free( operand, sizeof( *operand ) );
    return node;
 }
 
@@ -657,11 +660,12 @@ static void recover_expr( struct recovery* recovery,
    struct expr* expr = alloc_expr();
    expr->root = pop( recovery, expr_recovery, PRECEDENCE_BOTTOM );
    expr_recovery->output_node = expr;
-   if ( list_size( &expr_recovery->stack ) != 0 ) {
+   if ( vec_size( &expr_recovery->stack ) != 0 ) {
       t_diag( recovery->task, DIAG_INTERNAL | DIAG_ERR,
          "stack size not 0" );
       t_bail( recovery->task );
    }
+   vec_deinit( &expr_recovery->stack );
 }
 
 static void examine_expr( struct recovery* recovery,
@@ -674,406 +678,93 @@ static void examine_expr( struct recovery* recovery,
 
 static void recover_operand( struct recovery* recovery,
    struct expr_recovery* expr_recovery ) {
-   switch ( expr_recovery->range.pcode->opcode ) {
-   case PCD_ORLOGICAL:
-   case PCD_ANDLOGICAL:
-   case PCD_ORBITWISE:
-   case PCD_EORBITWISE:
-   case PCD_ANDBITWISE:
-   case PCD_EQ:
-   case PCD_NE:
-   case PCD_LT:
-   case PCD_LE:
-   case PCD_GT:
-   case PCD_GE:
-   case PCD_LSHIFT:
-   case PCD_RSHIFT:
-   case PCD_ADD:
-   case PCD_SUBTRACT:
-   case PCD_MULTIPLY:
-   case PCD_DIVIDE:
-   case PCD_MODULUS:
+   switch ( c_get_stack_effect( ( enum pcd )
+      expr_recovery->range.pcode->opcode )->kind ) {
+   case OPERAND_BINARY:
       recover_binary( recovery, expr_recovery );
       break;
-   case PCD_NEGATELOGICAL:
-   case PCD_NEGATEBINARY:
+   case OPERAND_UNARY:
       recover_unary( recovery, expr_recovery );
       break;
-   case PCD_UNARYMINUS:
+   case OPERAND_MINUS:
       recover_minus( recovery, expr_recovery );
       break;
-   case PCD_INCSCRIPTVAR:
-   case PCD_INCMAPVAR:
-   case PCD_INCWORLDVAR:
-   case PCD_INCGLOBALVAR:
-   case PCD_DECSCRIPTVAR:
-   case PCD_DECMAPVAR:
-   case PCD_DECWORLDVAR:
-   case PCD_DECGLOBALVAR:
+   case OPERAND_INC:
       recover_inc( recovery, expr_recovery );
       break;
-   case PCD_INCSCRIPTARRAY:
-   case PCD_INCMAPARRAY:
-   case PCD_INCWORLDARRAY:
-   case PCD_INCGLOBALARRAY:
-   case PCD_DECSCRIPTARRAY:
-   case PCD_DECMAPARRAY:
-   case PCD_DECWORLDARRAY:
-   case PCD_DECGLOBALARRAY:
+   case OPERAND_ARRAYINC:
       recover_array_inc( recovery, expr_recovery );
       break;
-   case PCD_ASSIGNSCRIPTVAR:
-   case PCD_ADDSCRIPTVAR:
-   case PCD_SUBSCRIPTVAR:
-   case PCD_MULSCRIPTVAR:
-   case PCD_DIVSCRIPTVAR:
-   case PCD_MODSCRIPTVAR:
-   case PCD_ANDSCRIPTVAR:
-   case PCD_EORSCRIPTVAR:
-   case PCD_ORSCRIPTVAR:
-   case PCD_LSSCRIPTVAR:
-   case PCD_RSSCRIPTVAR:
-   case PCD_ASSIGNMAPVAR:
-   case PCD_ADDMAPVAR:
-   case PCD_SUBMAPVAR:
-   case PCD_MULMAPVAR:
-   case PCD_DIVMAPVAR:
-   case PCD_MODMAPVAR:
-   case PCD_ANDMAPVAR:
-   case PCD_EORMAPVAR:
-   case PCD_ORMAPVAR:
-   case PCD_LSMAPVAR:
-   case PCD_RSMAPVAR:
-   case PCD_ASSIGNWORLDVAR:
-   case PCD_ADDWORLDVAR:
-   case PCD_SUBWORLDVAR:
-   case PCD_MULWORLDVAR:
-   case PCD_DIVWORLDVAR:
-   case PCD_MODWORLDVAR:
-   case PCD_ANDWORLDVAR:
-   case PCD_EORWORLDVAR:
-   case PCD_ORWORLDVAR:
-   case PCD_LSWORLDVAR:
-   case PCD_RSWORLDVAR:
-   case PCD_ASSIGNGLOBALVAR:
-   case PCD_ADDGLOBALVAR:
-   case PCD_SUBGLOBALVAR:
-   case PCD_MULGLOBALVAR:
-   case PCD_DIVGLOBALVAR:
-   case PCD_MODGLOBALVAR:
-   case PCD_ANDGLOBALVAR:
-   case PCD_EORGLOBALVAR:
-   case PCD_ORGLOBALVAR:
-   case PCD_LSGLOBALVAR:
-   case PCD_RSGLOBALVAR:
+   case OPERAND_ASSIGN:
       recover_assign( recovery, expr_recovery );
       break;
-   case PCD_ASSIGNSCRIPTARRAY:
-   case PCD_ADDSCRIPTARRAY:
-   case PCD_SUBSCRIPTARRAY:
-   case PCD_MULSCRIPTARRAY:
-   case PCD_DIVSCRIPTARRAY:
-   case PCD_MODSCRIPTARRAY:
-   case PCD_ANDSCRIPTARRAY:
-   case PCD_EORSCRIPTARRAY:
-   case PCD_ORSCRIPTARRAY:
-   case PCD_LSSCRIPTARRAY:
-   case PCD_RSSCRIPTARRAY:
-   case PCD_ASSIGNMAPARRAY:
-   case PCD_ADDMAPARRAY:
-   case PCD_SUBMAPARRAY:
-   case PCD_MULMAPARRAY:
-   case PCD_DIVMAPARRAY:
-   case PCD_MODMAPARRAY:
-   case PCD_ANDMAPARRAY:
-   case PCD_EORMAPARRAY:
-   case PCD_ORMAPARRAY:
-   case PCD_LSMAPARRAY:
-   case PCD_RSMAPARRAY:
-   case PCD_ASSIGNWORLDARRAY:
-   case PCD_ADDWORLDARRAY:
-   case PCD_SUBWORLDARRAY:
-   case PCD_MULWORLDARRAY:
-   case PCD_DIVWORLDARRAY:
-   case PCD_MODWORLDARRAY:
-   case PCD_ANDWORLDARRAY:
-   case PCD_EORWORLDARRAY:
-   case PCD_ORWORLDARRAY:
-   case PCD_LSWORLDARRAY:
-   case PCD_RSWORLDARRAY:
-   case PCD_ASSIGNGLOBALARRAY:
-   case PCD_ADDGLOBALARRAY:
-   case PCD_SUBGLOBALARRAY:
-   case PCD_MULGLOBALARRAY:
-   case PCD_DIVGLOBALARRAY:
-   case PCD_MODGLOBALARRAY:
-   case PCD_ANDGLOBALARRAY:
-   case PCD_EORGLOBALARRAY:
-   case PCD_ORGLOBALARRAY:
-   case PCD_LSGLOBALARRAY:
-   case PCD_RSGLOBALARRAY:
+   case OPERAND_ASSIGNARRAY:
       recover_assign_array( recovery, expr_recovery );
       break;
-   case PCD_LSPEC1:
-   case PCD_LSPEC2:
-   case PCD_LSPEC3:
-   case PCD_LSPEC4:
-   case PCD_LSPEC5:
-   case PCD_LSPEC1DIRECT:
-   case PCD_LSPEC2DIRECT:
-   case PCD_LSPEC3DIRECT:
-   case PCD_LSPEC4DIRECT:
-   case PCD_LSPEC5DIRECT:
-   case PCD_LSPEC1DIRECTB:
-   case PCD_LSPEC2DIRECTB:
-   case PCD_LSPEC3DIRECTB:
-   case PCD_LSPEC4DIRECTB:
-   case PCD_LSPEC5DIRECTB:
-   case PCD_LSPEC5RESULT:
-   case PCD_LSPEC5EX:
-   case PCD_LSPEC5EXRESULT:
+   case OPERAND_ASPEC:
+   case OPERAND_ASPECDIRECT:
+   case OPERAND_ASPECFIXED:
       recover_call_aspec( recovery, expr_recovery );
       break;
-   case PCD_CALLFUNC:
+   case OPERAND_CALLEXT:
       recover_call_ext( recovery, expr_recovery );
       break;
-   case PCD_DELAY:
-   case PCD_RANDOM:
-   case PCD_THINGCOUNT:
-   case PCD_TAGWAIT:
-   case PCD_POLYWAIT:
-   case PCD_CHANGEFLOOR:
-   case PCD_CHANGECEILING:
-   case PCD_LINESIDE:
-   case PCD_SCRIPTWAIT:
-   case PCD_CLEARLINESPECIAL:
-   case PCD_PLAYERCOUNT:
-   case PCD_GAMETYPE:
-   case PCD_GAMESKILL:
-   case PCD_TIMER:
-   case PCD_SECTORSOUND:
-   case PCD_AMBIENTSOUND:
-   case PCD_SOUNDSEQUENCE:
-   case PCD_SETLINETEXTURE:
-   case PCD_SETLINEBLOCKING:
-   case PCD_SETLINESPECIAL:
-   case PCD_THINGSOUND:
-   case PCD_ACTIVATORSOUND:
-   case PCD_LOCALAMBIENTSOUND:
-   case PCD_SETLINEMONSTERBLOCKING:
-   case PCD_ISNETWORKGAME:
-   case PCD_PLAYERTEAM:
-   case PCD_PLAYERHEALTH:
-   case PCD_PLAYERARMORPOINTS:
-   case PCD_PLAYERFRAGS:
-   case PCD_BLUETEAMCOUNT:
-   case PCD_REDTEAMCOUNT:
-   case PCD_BLUETEAMSCORE:
-   case PCD_REDTEAMSCORE:
-   case PCD_ISONEFLAGCTF:
-   case PCD_GETINVASIONWAVE:
-   case PCD_GETINVASIONSTATE:
-   case PCD_MUSICCHANGE:
-   case PCD_CONSOLECOMMAND:
-   case PCD_SINGLEPLAYER:
-   case PCD_FIXEDMUL:
-   case PCD_FIXEDDIV:
-   case PCD_SETGRAVITY:
-   case PCD_SETAIRCONTROL:
-   case PCD_CLEARINVENTORY:
-   case PCD_GIVEINVENTORY:
-   case PCD_TAKEINVENTORY:
-   case PCD_CHECKINVENTORY:
-   case PCD_SPAWN:
-   case PCD_SPAWNSPOT:
-   case PCD_SETMUSIC:
-   case PCD_LOCALSETMUSIC:
-   case PCD_SETFONT:
-   case PCD_SETTHINGSPECIAL:
-   case PCD_FADETO:
-   case PCD_FADERANGE:
-   case PCD_CANCELFADE:
-   case PCD_PLAYMOVIE:
-   case PCD_SETFLOORTRIGGER:
-   case PCD_SETCEILINGTRIGGER:
-   case PCD_GETACTORX:
-   case PCD_GETACTORY:
-   case PCD_GETACTORZ:
-   case PCD_SIN:
-   case PCD_COS:
-   case PCD_VECTORANGLE:
-   case PCD_CHECKWEAPON:
-   case PCD_SETWEAPON:
-   case PCD_SETMARINEWEAPON:
-   case PCD_SETACTORPROPERTY:
-   case PCD_GETACTORPROPERTY:
-   case PCD_PLAYERNUMBER:
-   case PCD_ACTIVATORTID:
-   case PCD_SETMARINESPRITE:
-   case PCD_GETSCREENWIDTH:
-   case PCD_GETSCREENHEIGHT:
-   case PCD_THINGPROJECTILE2:
-   case PCD_STRLEN:
-   case PCD_SETHUDSIZE:
-   case PCD_GETCVAR:
-   case PCD_SETRESULTVALUE:
-   case PCD_GETLINEROWOFFSET:
-   case PCD_GETACTORFLOORZ:
-   case PCD_GETACTORANGLE:
-   case PCD_GETSECTORFLOORZ:
-   case PCD_GETSECTORCEILINGZ:
-   case PCD_GETSIGILPIECES:
-   case PCD_GETLEVELINFO:
-   case PCD_CHANGESKY:
-   case PCD_PLAYERINGAME:
-   case PCD_PLAYERISBOT:
-   case PCD_SETCAMERATOTEXTURE:
-   case PCD_GETAMMOCAPACITY:
-   case PCD_SETAMMOCAPACITY:
-   case PCD_SETACTORANGLE:
-   case PCD_SPAWNPROJECTILE:
-   case PCD_GETSECTORLIGHTLEVEL:
-   case PCD_GETACTORCEILINGZ:
-   case PCD_SETACTORPOSITION:
-   case PCD_CLEARACTORINVENTORY:
-   case PCD_GIVEACTORINVENTORY:
-   case PCD_TAKEACTORINVENTORY:
-   case PCD_CHECKACTORINVENTORY:
-   case PCD_THINGCOUNTNAME:
-   case PCD_SPAWNSPOTFACING:
-   case PCD_PLAYERCLASS:
-   case PCD_GETPLAYERINFO:
-   case PCD_CHANGELEVEL:
-   case PCD_SECTORDAMAGE:
-   case PCD_REPLACETEXTURES:
-   case PCD_GETACTORPITCH:
-   case PCD_SETACTORPITCH:
-   case PCD_SETACTORSTATE:
-   case PCD_THINGDAMAGE2:
-   case PCD_USEINVENTORY:
-   case PCD_USEACTORINVENTORY:
-   case PCD_CHECKACTORCEILINGTEXTURE:
-   case PCD_CHECKACTORFLOORTEXTURE:
-   case PCD_GETACTORLIGHTLEVEL:
-   case PCD_SETMUGSHOTSTATE:
-   case PCD_THINGCOUNTSECTOR:
-   case PCD_THINGCOUNTNAMESECTOR:
-   case PCD_CHECKPLAYERCAMERA:
-   case PCD_MORPHACTOR:
-   case PCD_UNMORPHACTOR:
-   case PCD_GETPLAYERINPUT:
-   case PCD_CLASSIFYACTOR:
-   case PCD_SCRIPTWAITNAMED:
+   case OPERAND_DED:
       recover_call_ded( recovery, expr_recovery );
       break;
-   case PCD_DELAYDIRECT:
-   case PCD_RANDOMDIRECT:
-   case PCD_THINGCOUNTDIRECT:
-   case PCD_TAGWAITDIRECT:
-   case PCD_POLYWAITDIRECT:
-   case PCD_CHANGEFLOORDIRECT:
-   case PCD_CHANGECEILINGDIRECT:
-   case PCD_SCRIPTWAITDIRECT:
-   case PCD_CONSOLECOMMANDDIRECT:
-   case PCD_SETGRAVITYDIRECT:
-   case PCD_SETAIRCONTROLDIRECT:
-   case PCD_GIVEINVENTORYDIRECT:
-   case PCD_TAKEINVENTORYDIRECT:
-   case PCD_CHECKINVENTORYDIRECT:
-   case PCD_SPAWNDIRECT:
-   case PCD_SPAWNSPOTDIRECT:
-   case PCD_SETMUSICDIRECT:
-   case PCD_LOCALSETMUSICDIRECT:
-   case PCD_SETSTYLEDIRECT:
-   case PCD_SETFONTDIRECT:
-   case PCD_DELAYDIRECTB:
-   case PCD_RANDOMDIRECTB:
+   case OPERAND_DEDDIRECT:
       recover_call_ded_direct( recovery, expr_recovery );
       break;
-   case PCD_CALL:
-   case PCD_CALLDISCARD:
+   case OPERAND_CALLUSER:
       recover_call_user( recovery, expr_recovery );
       break;
-   case PCD_PUSHNUMBER:
-   case PCD_PUSHBYTE:
-   case PCD_PUSH2BYTES:
-   case PCD_PUSH3BYTES:
-   case PCD_PUSH4BYTES:
-   case PCD_PUSH5BYTES:
-   case PCD_PUSHBYTES:
+   case OPERAND_LITERAL:
       recover_literal( expr_recovery );
       break;
-   case PCD_DUP:
+   case OPERAND_DUP:
       examine_dup( recovery, expr_recovery );
       break;
-   case PCD_PUSHSCRIPTVAR:
-   case PCD_PUSHMAPVAR:
-   case PCD_PUSHWORLDVAR:
+   case OPERAND_PUSHVAR:
       examine_pushvar( recovery, expr_recovery );
       break;
-   case PCD_PUSHSCRIPTARRAY:
-   case PCD_PUSHMAPARRAY:
-   case PCD_PUSHWORLDARRAY:
-   case PCD_PUSHGLOBALARRAY:
+   case OPERAND_PUSHARRAY:
       examine_pusharray( recovery, expr_recovery );
       break;
-   case PCD_BEGINPRINT:
+   case OPERAND_BEGINPRINT:
       examine_beginprint( recovery, expr_recovery );
       break;
-   case PCD_PRINTSTRING:
-   case PCD_PRINTNUMBER:
-   case PCD_PRINTCHARACTER:
-   case PCD_PRINTFIXED:
-   case PCD_PRINTNAME:
-   case PCD_PRINTLOCALIZED:
-   case PCD_PRINTBIND:
-   case PCD_PRINTBINARY:
-   case PCD_PRINTHEX:
+   case OPERAND_PRINTVALUE:
       examine_printvalue( recovery, expr_recovery );
       break;
-   case PCD_PRINTMAPCHARARRAY:
-   case PCD_PRINTMAPCHRANGE:
-   case PCD_PRINTWORLDCHARARRAY:
-   case PCD_PRINTWORLDCHRANGE:
-   case PCD_PRINTGLOBALCHARARRAY:
-   case PCD_PRINTGLOBALCHRANGE:
+   case OPERAND_PRINTARRAY:
       examine_printarray( recovery, expr_recovery );
       break;
-   case PCD_MOREHUDMESSAGE:
+   case OPERAND_MOREHUDMESSAGE:
       expr_recovery->format_call->args_start =
-         list_size( &expr_recovery->stack );
+         vec_size( &expr_recovery->stack );
       next_pcode( &expr_recovery->range );
       break;
-   case PCD_OPTHUDMESSAGE:
+   case OPERAND_OPTHUDMESSAGE:
       next_pcode( &expr_recovery->range );
       break;
-   case PCD_ENDPRINT:
-   case PCD_ENDPRINTBOLD:
-   case PCD_ENDHUDMESSAGE:
-   case PCD_ENDHUDMESSAGEBOLD:
-   case PCD_ENDLOG:
-   case PCD_SAVESTRING:
+   case OPERAND_ENDPRINT:
+   case OPERAND_ENDHUDMESSAGE:
+   case OPERAND_SAVESTRING:
       examine_endprint( recovery, expr_recovery );
       break;
-   case PCD_STRCPYTOMAPCHRANGE:
-   case PCD_STRCPYTOWORLDCHRANGE:
-   case PCD_STRCPYTOGLOBALCHRANGE:
+   case OPERAND_STRCPY:
       examine_strcpy( recovery, expr_recovery );
       break;
-   case PCD_STARTTRANSLATION:
+   case OPERAND_STARTTRANSLATION:
       examine_starttranslation( recovery, expr_recovery );
       break;
-   case PCD_TRANSLATIONRANGE1:
-   case PCD_TRANSLATIONRANGE2:
-   case PCD_TRANSLATIONRANGE3:
-   case PCD_TRANSLATIONRANGE4:
-   case PCD_TRANSLATIONRANGE5:
+   case OPERAND_TRANSLATIONRANGE:
       examine_translationrange( recovery, expr_recovery );
       break;
-   case PCD_ENDTRANSLATION:
+   case OPERAND_ENDTRANSLATION:
       examine_endtranslation( recovery, expr_recovery );
       break;
-   case PCD_TAGSTRING:
+   case OPERAND_TAGSTRING:
       next_pcode( &expr_recovery->range );
       break;
    default:
@@ -1496,7 +1187,7 @@ static void recover_assign_array( struct recovery* recovery,
 static struct node* recover_var( struct recovery* recovery,
    struct expr_recovery* expr_recovery ) {
    struct var* var = NULL;
-   u32 index = ( u32 ) expr_recovery->range.generic->args->value;
+   u32 index = ( u32 ) expr_recovery->range.generic->args[ 0 ];
    struct var** list = NULL;
    switch ( expr_recovery->range.pcode->opcode ) {
    case PCD_PUSHSCRIPTVAR:
@@ -1508,7 +1199,7 @@ static struct node* recover_var( struct recovery* recovery,
    case PCD_MODSCRIPTVAR:
    case PCD_INCSCRIPTVAR:
    case PCD_DECSCRIPTVAR:
-      index = ( u32 ) expr_recovery->range.generic->args->value;
+      index = ( u32 ) expr_recovery->range.generic->args[ 0 ];
       if ( recovery->script ) {
          if ( ! ( index < recovery->script->num_vars ) ) {
             t_diag( recovery->task, DIAG_ERR,
@@ -1550,7 +1241,9 @@ static struct node* recover_var( struct recovery* recovery,
    case PCD_RSSCRIPTARRAY:
    case PCD_INCSCRIPTARRAY:
    case PCD_DECSCRIPTARRAY:
-      index = ( u32 ) expr_recovery->range.generic->args->value;
+      index = ( u32 ) expr_recovery->range.generic->args[ 0 ];
+      // The dimensions of local arrays are not part of the body.
+      recovery->body->reusable = false;
       if ( recovery->script ) {
          if ( ! recovery->script->arrays[ index ] ) {
             var = alloc_var();
@@ -1591,7 +1284,7 @@ static struct node* recover_var( struct recovery* recovery,
    case PCD_RSMAPARRAY:
    case PCD_INCMAPARRAY:
    case PCD_DECMAPARRAY:
-      index = ( u32 ) expr_recovery->range.generic->args->value;
+      index = ( u32 ) expr_recovery->range.generic->args[ 0 ];
       if ( ! recovery->task->map_vars[ index ] ) {
          var = alloc_var();
          var->storage = STORAGE_MAP;
@@ -1609,7 +1302,7 @@ static struct node* recover_var( struct recovery* recovery,
    case PCD_MODWORLDVAR:
    case PCD_INCWORLDVAR:
    case PCD_DECWORLDVAR:
-      index = ( u32 ) expr_recovery->range.generic->args->value;
+      index = ( u32 ) expr_recovery->range.generic->args[ 0 ];
       if ( ! recovery->task->world_vars[ index ] ) {
          var = alloc_var();
          var->storage = STORAGE_WORLD;
@@ -1632,7 +1325,7 @@ static struct node* recover_var( struct recovery* recovery,
    case PCD_RSWORLDARRAY:
    case PCD_INCWORLDARRAY:
    case PCD_DECWORLDARRAY:
-      index = ( u32 ) expr_recovery->range.generic->args->value;
+      index = ( u32 ) expr_recovery->range.generic->args[ 0 ];
       if ( ! recovery->task->world_arrays[ index ] ) {
          var = alloc_var();
          var->storage = STORAGE_WORLD;
@@ -1651,7 +1344,7 @@ static struct node* recover_var( struct recovery* recovery,
    case PCD_MODGLOBALVAR:
    case PCD_INCGLOBALVAR:
    case PCD_DECGLOBALVAR:
-      index = ( u32 ) expr_recovery->range.generic->args->value;
+      index = ( u32 ) expr_recovery->range.generic->args[ 0 ];
       if ( ! recovery->task->global_vars[ index ] ) {
          var = alloc_var();
          var->storage = STORAGE_GLOBAL;
@@ -1674,7 +1367,7 @@ static struct node* recover_var( struct recovery* recovery,
    case PCD_RSGLOBALARRAY:
    case PCD_INCGLOBALARRAY:
    case PCD_DECGLOBALARRAY:
-      index = ( u32 ) expr_recovery->range.generic->args->value;
+      index = ( u32 ) expr_recovery->range.generic->args[ 0 ];
       if ( ! recovery->task->global_arrays[ index ] ) {
          var = alloc_var();
          var->storage = STORAGE_GLOBAL;
@@ -1689,6 +1382,9 @@ printf( "%d\n", expr_recovery->range.pcode->opcode );
       UNREACHABLE();
       t_bail( recovery->task );
    }
+   if ( var->storage != STORAGE_LOCAL ) {
+      recovery->body->reusable = false;
+   }
    return ( struct node* ) var;
 }
 
@@ -1712,7 +1408,7 @@ static struct var* alloc_script_var( struct recovery* recovery, u32 index ) {
 static struct var* alloc_var( void ) {
    struct var* var = mem_alloc( sizeof( *var ) );
    var->node.type = NODE_VAR;
-   str_init( &var->name );
+   var->name = NULL;
    var->initz = NULL;
    var->value = NULL;
    var->storage = STORAGE_LOCAL;
@@ -2064,7 +1760,7 @@ static void recover_call_aspec( struct recovery* recovery,
       call->direct = true;
       break;
    }
-   i32 id = expr_recovery->range.generic->args->value;
+   i32 id = expr_recovery->range.generic->args[ 0 ];
    if ( id >= 0 && ( u32 ) id < ARRAY_SIZE( table ) ) {
       call->operand = &table[ id ].node;
    }
@@ -2075,14 +1771,13 @@ static void recover_call_aspec( struct recovery* recovery,
       call->operand = &unknown->node;
    }
    if ( call->direct ) {
-      struct generic_pcode_arg* arg = expr_recovery->range.generic->args->next;
-      while ( arg ) {
+      struct generic_pcode* generic = expr_recovery->range.generic;
+      for ( i32 i = 1; i < generic->num_args; ++i ) {
          struct literal* literal = alloc_literal();
-         literal->value = arg->value;
+         literal->value = generic->args[ i ];
          struct expr* expr = alloc_expr();
          expr->root = &literal->node;
          list_append( &call->args, expr );
-         arg = arg->next;
       }
    }
    else {
@@ -2113,6 +1808,7 @@ static void recover_call_aspec( struct recovery* recovery,
    push( expr_recovery, &call->node, PRECEDENCE_TOP );
    next_pcode( &expr_recovery->range );
    recovery->task->calls_aspec = true;
+   recovery->body->calls_aspec = true;
 }
 
 struct expr* t_alloc_literal_expr( i32 value ) {
@@ -2139,17 +1835,17 @@ static void recover_call_ext( struct recovery* recovery,
    }
    struct call* call = alloc_call();
    struct func* func = t_find_ext_func( recovery->task,
-      expr_recovery->range.generic->args->next->value );
+      expr_recovery->range.generic->args[ 1 ] );
    if ( func ) {
       call->operand = &func->node;
    }
    else {
       struct unknown* unknown = alloc_unknown();
       unknown->type = UNKNOWN_EXT;
-      unknown->more.ext.id = expr_recovery->range.generic->args->next->value;
+      unknown->more.ext.id = expr_recovery->range.generic->args[ 1 ];
       call->operand = &unknown->node;
    }
-   for ( i32 i = 0; i < expr_recovery->range.generic->args->value; ++i ) {
+   for ( i32 i = 0; i < expr_recovery->range.generic->args[ 0 ]; ++i ) {
       struct expr* expr = alloc_expr();
       expr->root = pop( recovery, expr_recovery, PRECEDENCE_BOTTOM );
       list_prepend( &call->args, expr );
@@ -2157,6 +1853,7 @@ static void recover_call_ext( struct recovery* recovery,
    push( expr_recovery, &call->node, PRECEDENCE_TOP );
    next_pcode( &expr_recovery->range );
    recovery->task->calls_ext = true;
+   recovery->body->calls_ext = true;
 }
 
 static void recover_call_intern( struct recovery* recovery,
@@ -2203,14 +1900,13 @@ static void recover_call_ded_direct( struct recovery* recovery,
    struct call* call = alloc_call();
    call->operand = &func->node;
    call->direct = true;
-   struct generic_pcode_arg* arg = expr_recovery->range.generic->args;
-   while ( arg ) {
+   struct generic_pcode* generic = expr_recovery->range.generic;
+   for ( i32 i = 0; i < generic->num_args; ++i ) {
       struct literal* literal = alloc_literal();
-      literal->value = arg->value;
+      literal->value = generic->args[ i ];
       struct expr* expr = alloc_expr();
       expr->root = &literal->node;
       list_append( &call->args, expr );
-      arg = arg->next;
    }
    push( expr_recovery, &call->node, PRECEDENCE_TOP );
    next_pcode( &expr_recovery->range );
@@ -2240,7 +1936,7 @@ static void examine_beginprint( struct recovery* recovery,
    struct call* call = alloc_call();
    call->operand = &call_recovery.func->node;
    call->format_item = call_recovery.format_item;
-   u32 num_regular_args = list_size( &expr_recovery->stack ) -
+   u32 num_regular_args = vec_size( &expr_recovery->stack ) -
       call_recovery.args_start;
    for ( u32 i = 0; i < num_regular_args; ++i ) {
       struct expr* expr = alloc_expr();
@@ -2357,6 +2053,7 @@ printf( "%d\n", expr_recovery->range.pcode->opcode );
       UNREACHABLE();
       t_bail( recovery->task );
    }
+   recovery->body->reusable = false;
    struct node* root = &var->node;
    if ( ! ( sub_idx->type == NODE_LITERAL &&
       ( ( struct literal* ) sub_idx )->value == 0 ) ) {
@@ -2517,7 +2214,7 @@ static void examine_endtranslation( struct recovery* recovery,
 static void recover_call_user( struct recovery* recovery,
    struct expr_recovery* expr_recovery ) {
    struct func* func = t_find_func( recovery->task,
-      ( u32 ) expr_recovery->range.generic->args->value );
+      ( u32 ) expr_recovery->range.generic->args[ 0 ] );
    struct call* call = alloc_call();
    call->operand = &func->node;
    for ( i32 i = 0; i < func->max_param; ++i ) {
@@ -2530,16 +2227,16 @@ static void recover_call_user( struct recovery* recovery,
 }
 
 static void recover_literal( struct expr_recovery* recovery ) {
-   struct generic_pcode_arg* arg = recovery->range.generic->args;
+   struct generic_pcode* generic = recovery->range.generic;
+   i32 i = 0;
    // Skip argument-count argument.
    if ( recovery->range.pcode->opcode == PCD_PUSHBYTES ) {
-      arg = arg->next;
+      ++i;
    }
-   while ( arg ) {
+   for ( ; i < generic->num_args; ++i ) {
       struct literal* literal = alloc_literal();
-      literal->value = arg->value;
+      literal->value = generic->args[ i ];
       push( recovery, &literal->node, PRECEDENCE_TOP );
-      arg = arg->next;
    }
    next_pcode( &recovery->range );
 }
@@ -2553,7 +2250,7 @@ static struct literal* alloc_literal( void ) {
 
 static void examine_dup( struct recovery* recovery,
    struct expr_recovery* expr_recovery ) {
-   struct operand* operand = list_head( &expr_recovery->stack );
+   struct operand* operand = vec_tail( &expr_recovery->stack );
 printf( "%p\n", ( void* ) operand );
    push( expr_recovery, operand->node, operand->precedence );
    next_pcode( &expr_recovery->range );
@@ -2582,7 +2279,8 @@ static void init_range( struct pcode_range* range, struct pcode* start,
 }
 
 static bool have_pcode( struct pcode_range* range ) {
-   return ( range->pcode->obj_pos <= range->end->obj_pos );
+   return ( ( union pcode_slot* ) range->pcode <=
+      ( union pcode_slot* ) range->end );
 }
 
 static void seek_pcode( struct pcode_range* range, struct pcode* pcode ) {
@@ -2609,5 +2307,5 @@ static void seek_pcode( struct pcode_range* range, struct pcode* pcode ) {
 }
 
 static void next_pcode( struct pcode_range* range ) {
-   seek_pcode( range, range->pcode->next );
+   seek_pcode( range, PCODE_NEXT( range->pcode ) );
 }
@@ -6,10 +6,69 @@
 #include "common.h"
 #include "pcode.h"
 
+// A script or function that the user asked to be decompiled. A script is
+// selected by number or by name, and a function by name.
+struct selection {
+   const char* value;
+   bool func;
+};
+
 struct options {
    const char* object_file;
    const char* source_file;
+   // When empty, everything is decompiled.
+   struct selection* selections;
+   u32 num_selections;
    bool disassemble;
+   bool mem_stats;
+   bool use_cache;
+};
+
+// An ACS object in memory. The object is either the whole object file or a
+// lump of a WAD file.
+struct object_input {
+   const u8* data;
+   size_t size;
+   // Name of the lump, or NULL when the object is the whole object file.
+   const char* lump_name;
+   // File the source code is written to. NULL selects standard output.
+   const char* output_file;
+};
+
+// Source code of an object, stored in the output cache. The paths are NULL
+// when the output of the object is not cached.
+struct cache_entry {
+   char* dir;
+   char* path;
+   // The source code is written here first, and moved to the path once it is
+   // complete, so a partially written entry is never read.
+   char* temp_path;
+};
+
+enum cache_fetch {
+   CACHE_HIT,
+   CACHE_MISS,
+   // The source code is in the cache, but could not be copied to the output.
+   CACHE_ERROR
+};
+
+// A script or function in the body cache. Many objects contain the same
+// scripts and functions, such as the library code compiled into each map of a
+// WAD file, so the source code of a body is stored and reused by other objects
+// with the same body.
+struct cached_body {
+   u64 key;
+   // Source code of the body, taken from the cache. NULL when the body is
+   // decompiled.
+   const char* text;
+   // Cleared when the source code of the body cannot be reused. The names and
+   // declarations of map, world, and global variables depend on the rest of
+   // the object, so a body that uses those variables is not cached.
+   bool reusable;
+   // Whether the body calls action specials or extension functions. Restored
+   // from the cache, because it decides whether zcommon.acs is included.
+   bool calls_aspec;
+   bool calls_ext;
 };
 
 // ==========================================================================
@@ -25,8 +84,6 @@ struct acs_object {
 };
 
 struct pcode {
-   struct pcode* prev;
-   struct pcode* next;
 /*
    struct pcode_arg* args;
    union {
@@ -54,7 +111,6 @@ struct jump_pcode {
 // - PCD_CASEGOTO
 struct casejump_pcode {
    struct pcode pcode;
-   struct casejump_pcode* next;
    struct pcode* destination;
    i32 destination_obj_pos;
    i32 value;
@@ -64,22 +120,31 @@ struct casejump_pcode {
 // - PCD_CASEGOTOSORTED
 struct sortedcasejump_pcode {
    struct pcode pcode;
-   struct casejump_pcode* head;
-   struct casejump_pcode* tail;
+   struct casejump_pcode* cases;
    i32 count;
 };
 
 struct generic_pcode {
    struct pcode pcode;
-   struct generic_pcode_arg* args;
-   struct generic_pcode_arg* args_tail;
+   i32* args;
+   i32 num_args;
 };
 
-struct generic_pcode_arg {
-   struct generic_pcode_arg* next;
-   i32 value;
+// The pcode of a script or function is stored in a single array, in the order
+// it appears in the object file. The array starts and ends with a sentinel.
+// Neighboring pcode is found by index arithmetic. The arguments of generic
+// pcode and the cases of PCD_CASEGOTOSORTED are kept in side arrays.
+union pcode_slot {
+   struct pcode pcode;
+   struct jump_pcode jump;
+   struct casejump_pcode casejump;
+   struct sortedcasejump_pcode sortedcasejump;
+   struct generic_pcode generic;
 };
 
+#define PCODE_NEXT( x ) ( &( ( union pcode_slot* ) ( x ) + 1 )->pcode )
+#define PCODE_PREV( x ) ( &( ( union pcode_slot* ) ( x ) - 1 )->pcode )
+
 struct pcode_range {
    struct pcode* start;
    struct pcode* end;
@@ -164,7 +229,7 @@ struct for_note {
    struct pcode* body_start;
    struct pcode* body_end;
    struct pcode* exit;
-   struct list post;
+   struct vec post;
 };
 
 struct for_note_post {
@@ -497,7 +562,7 @@ struct expr_stmt {
 
 struct block {
    struct node node;
-   struct list stmts;
+   struct vec stmts;
 };
 
 struct jump {
@@ -554,7 +619,7 @@ struct do_stmt {
 struct for_stmt {
    struct node node;
    struct expr* cond;
-   struct list post;
+   struct vec post;
    struct block* body;
 };
 
@@ -565,7 +630,7 @@ struct return_stmt {
 
 struct inline_asm {
    struct node node;
-   struct pcode* pcode;
+   i32 opcode;
 };
 
 struct initial {
@@ -592,7 +657,7 @@ struct multi_value {
 
 struct var {
    struct node node;
-   struct str name;
+   const struct istr* name;
    struct expr* initz;
    struct initial* initial;
    struct value* value;
@@ -626,7 +691,7 @@ struct func {
       FUNC_USER,
       FUNC_INTERN,
    } type;
-   struct str name;
+   const struct istr* name;
    union {
       struct func_aspec* aspec;
       struct func_ext* ext;
@@ -667,6 +732,21 @@ struct aspec {
    const char* name;
 };
 
+// Jumps into the pcode of a script or function, found when the body is loaded
+// for decompiling. The targets and the incoming jumps are indexed by the position of the pcode
+// in the body, counted from the first pcode up to and including the trailing
+// sentinel, which is where a jump out of the body lands.
+struct jump_index {
+   struct pcode* start;
+   // One bit for each position. The bit is set when the pcode is jumped to.
+   u32* targets;
+   // The jumps to the pcode at position i are sources[ first_source[ i ] ]
+   // up to, but not including, sources[ first_source[ i + 1 ] ].
+   u32* first_source;
+   struct pcode** sources;
+   u32 num_slots;
+};
+
 // Functions created by the user.
 struct func_user {
    struct pcode* start;
@@ -678,6 +758,9 @@ struct func_user {
    u32 end_offset;
    u32 index;
    u32 num_vars;
+   struct jump_index jumps;
+   struct cached_body cache;
+   bool selected;
 /*
    struct list labels;
    struct block* body;
@@ -719,7 +802,7 @@ struct script {
    struct pcode* body_end;
    struct var** vars;
    struct var** arrays;
-   struct str name;
+   const struct istr* name;
    i32 number;
    u32 offset;
    u32 end_offset;
@@ -747,11 +830,50 @@ struct script {
    u32 flags;
    u32 num_vars;
    struct block* body;
+   struct jump_index jumps;
+   struct cached_body cache;
    bool named_script;
+   bool selected;
+};
+
+// Control-flow graph of a script or function.
+#define CFG_NO_BLOCK UINT_MAX
+
+// Position of a block in a dominator tree. The block dominates every block
+// whose enter and leave numbers fall within its own.
+struct cfg_dom_node {
+   u32 idom;
+   // Reverse postorder number of the block. CFG_NO_BLOCK when the block is
+   // unreachable.
+   u32 order;
+   u32 enter;
+   u32 leave;
+};
+
+struct cfg_block {
+   struct pcode* start;
+   struct pcode* end;
+   u32 first_succ;
+   u32 num_succs;
+   u32 first_pred;
+   u32 num_preds;
+   struct cfg_dom_node dom;
+};
+
+struct cfg {
+   struct pcode* start;
+   struct cfg_block* blocks;
+   // Block of each pcode, indexed by the position of the pcode in the body.
+   u32* block_of;
+   u32* succs;
+   u32* preds;
+   u32 num_blocks;
+   u32 num_edges;
+   u32 num_slots;
 };
 
 struct imported_module {
-   struct str name;
+   const struct istr* name;
 };
 
 #define DIAG_NONE 0
@@ -760,19 +882,39 @@ struct imported_module {
 #define DIAG_INTERNAL 0x40
 #define DIAG_NOTE 0x80
 
+enum stage {
+   STAGE_LOAD,
+   STAGE_ANNOTATE,
+   STAGE_RECOVER,
+   STAGE_ANALYZE,
+   STAGE_PUBLISH,
+   STAGE_TOTAL
+};
+
+STATIC_ASSERT( ( i32 ) STAGE_TOTAL <= ( i32 ) MEM_MAX_PHASES );
+
 struct task {
    jmp_buf bail;
    struct options* options;
-   struct {
-      struct pcode* head;
-      struct pcode* tail;
-      struct pcode* current;
-      struct generic_pcode_arg* args_tail;
-   } pcode_alloc;
+   // All of the memory of the task. Nothing is shared with other tasks, so
+   // tasks can be run on separate threads.
+   struct mem_arena arena;
+   // Output of the Loading and Annotation stages. It is only needed until the
+   // Recovery stage is done, so it is kept apart from the rest of the task.
+   struct mem_arena load_region;
+   // Additional regions that pcode is decoded into when decoding is spread
+   // over several threads. Released together with the load region.
+   struct vec decode_regions;
+   struct mem_arena annotate_region;
+   // Scratch memory of the Annotation stage, like the control-flow graph of
+   // the body being examined. Released after each body.
+   struct mem_arena body_region;
+   struct object_input input;
+   struct mem_stats mem_stats;
    struct str library_name;
-   struct list objects;
-   struct list scripts;
-   struct list funcs;
+   struct vec objects;
+   struct vec scripts;
+   struct vec funcs;
    struct list imports;
    struct var* map_vars[ 128 ];
    struct var* world_vars[ 256 ];
@@ -783,8 +925,22 @@ struct task {
    struct func** format_funcs;
    struct func** ext_funcs;
    struct func** intern_funcs;
-   struct str* strings;
+   // Identifiers and the entries of the string table of the object file.
+   struct str_table str_table;
+   const struct istr** strings;
    u32 num_strings;
+   // Where the string table is in the object data. The entries are decoded
+   // by t_lookup_string() when they are first needed.
+   struct {
+      const u8* data;
+      const u8* offsets;
+      u32 size;
+      const char* name;
+   } string_source;
+   // Directory of the body cache. NULL when bodies are not cached.
+   const char* cache_dir;
+   // Number of diagnostics shown while processing the object.
+   u32 num_diags;
    bool encrypt_str;
    bool importable;
    bool compact;
@@ -796,6 +952,10 @@ struct task {
 void t_create_builtins( struct task* task );
 void t_load( struct task* task );
 void t_show( struct task* task );
+void t_unload( struct task* task );
+bool t_is_jump_target( struct jump_index* index, struct pcode* pcode );
+struct pcode** t_find_jumps_to( struct jump_index* index, struct pcode* pcode,
+   u32* count );
 void t_annotate( struct task* task );
 void t_recover( struct task* task );
 void t_publish( struct task* task );
@@ -812,6 +972,7 @@ struct func* t_find_intern_func( struct task* task, i32 opcode );
 struct func* t_find_ext_func( struct task* task, i32 id );
 bool t_is_direct_pcode( i32 opcode );
 const char* t_lookup_string( struct task* task, u32 index );
+const char* t_find_string( struct task* task, u32 index );
 struct script* t_find_script( struct task* task, i32 number );
 struct func* t_find_func( struct task* task, u32 index );
 struct var* t_reserve_map_var( struct task* task, u32 index );
@@ -820,5 +981,18 @@ struct var* t_alloc_var( void );
 struct param* t_alloc_param( void );
 bool t_uses_zcommon_file( struct task* task );
 void t_analyze( struct task* task );
+void t_init_cache_entry( struct cache_entry* entry, struct options* options,
+   struct object_input* input );
+enum cache_fetch t_fetch_cache_entry( struct cache_entry* entry,
+   const char* output_file );
+bool t_store_cache_entry( struct cache_entry* entry, bool keep,
+   const char* output_file );
+void t_deinit_cache_entry( struct cache_entry* entry );
+void t_fetch_cached_bodies( struct task* task );
+void t_store_cached_body( struct task* task, struct cached_body* body,
+   const char* text );
+void t_build_cfg( struct cfg* cfg, struct pcode* start, struct pcode* end );
+bool t_cfg_closes_loop( struct cfg* cfg, struct pcode* jump,
+   struct pcode* destination );
 
 #endif